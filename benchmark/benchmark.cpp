@@ -0,0 +1,573 @@
+/**
+ * Measures serialize and deserialize for every archive and a range of type shapes, binary batches, and compress
+ * and decompress for every codec. Every measurement is printed as one JSON object per line, so results can be
+ * collected and compared between releases.
+ *
+ * usage: serializationpp_benchmark [iterations] [filter]
+ * Only measurements whose "archive/shape", or "codec/shape", contains filter are run.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+#include "serialization++.h"
+
+/** ALLOCATION COUNTING */
+namespace
+{
+    std::size_t allocations = 0;
+}
+
+// the replaced operators pair malloc with free, which GCC can't see through
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size)
+{
+    allocations++;
+    if(void* pointer = std::malloc(size ? size : 1))
+    {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+/** TYPE SHAPES */
+namespace shapes
+{
+    /**
+     * Deterministic pseudo random numbers, so every run encodes the same data.
+     */
+    class Random
+    {
+    private:
+        std::uint64_t state;
+    public:
+        explicit Random(std::uint64_t seed) : state(seed) {}
+
+        std::uint64_t next()
+        {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            return state >> 17;
+        }
+        std::string text(std::size_t length)
+        {
+            std::string result(length, ' ');
+            for(char& c : result)
+            {
+                c = static_cast<char>('a' + next() % 26);
+            }
+            return result;
+        }
+    };
+
+    struct Flat
+    {
+        int id = 0;
+        double score = 0;
+        bool active = false;
+        std::int64_t timestamp = 0;
+        float ratio = 0;
+        std::uint16_t flags = 0;
+
+        SERIALIZE(
+            STORE(&Flat::id, "id"),
+            STORE(&Flat::score, "score"),
+            STORE(&Flat::active, "active"),
+            STORE(&Flat::timestamp, "timestamp"),
+            STORE(&Flat::ratio, "ratio"),
+            STORE(&Flat::flags, "flags")
+        );
+
+        static Flat make(Random& random)
+        {
+            Flat flat;
+            flat.id = static_cast<int>(random.next());
+            flat.score = static_cast<double>(random.next()) / 1000.0;
+            flat.active = random.next() & 1;
+            flat.timestamp = static_cast<std::int64_t>(random.next());
+            flat.ratio = static_cast<float>(random.next() % 1000) / 7.0f;
+            flat.flags = static_cast<std::uint16_t>(random.next());
+            return flat;
+        }
+    };
+
+    class Human
+    {
+    protected:
+        std::string name;
+        int age = 0;
+    public:
+        SERIALIZE(
+            STORE(&Human::name, "name"),
+            STORE(&Human::age, "age")
+        );
+
+        static Human make(Random& random)
+        {
+            Human human;
+            human.name = random.text(12);
+            human.age = static_cast<int>(random.next() % 100);
+            return human;
+        }
+    };
+
+    class Parent : public Human
+    {
+    protected:
+        Human child;
+    public:
+        SERIALIZE_BASE(Human,
+            STORE(&Parent::child, "child")
+        );
+
+        static Parent make(Random& random)
+        {
+            Parent parent;
+            static_cast<Human&>(parent) = Human::make(random);
+            parent.child = Human::make(random);
+            return parent;
+        }
+    };
+
+    /**
+     * Four levels of nested objects.
+     */
+    struct Nested
+    {
+        struct Family
+        {
+            Parent mother;
+            Parent father;
+
+            SERIALIZE(
+                STORE(&Family::mother, "mother"),
+                STORE(&Family::father, "father")
+            );
+        };
+
+        Family first;
+        Family second;
+
+        SERIALIZE(
+            STORE(&Nested::first, "first"),
+            STORE(&Nested::second, "second")
+        );
+
+        static Nested make(Random& random)
+        {
+            Nested nested;
+            nested.first = Family { Parent::make(random), Parent::make(random) };
+            nested.second = Family { Parent::make(random), Parent::make(random) };
+            return nested;
+        }
+    };
+
+    struct Strings
+    {
+        std::string title;
+        std::string author;
+        std::string category;
+        std::string body;
+        std::string quoted;
+
+        SERIALIZE(
+            STORE(&Strings::title, "title"),
+            STORE(&Strings::author, "author"),
+            STORE(&Strings::category, "category"),
+            STORE(&Strings::body, "body"),
+            STORE(&Strings::quoted, "quoted")
+        );
+
+        static Strings make(Random& random)
+        {
+            Strings strings;
+            strings.title = random.text(40);
+            strings.author = random.text(16);
+            strings.category = random.text(8);
+            strings.body = random.text(1000);
+            strings.quoted = "\"" + random.text(30) + "\"\n\t\\" + random.text(30);
+            return strings;
+        }
+    };
+
+    struct Numbers
+    {
+        double a = 0, b = 0, c = 0, d = 0, e = 0, f = 0, g = 0, h = 0;
+        std::int64_t i = 0, j = 0, k = 0, l = 0;
+        std::uint32_t m = 0, n = 0;
+        std::int8_t o = 0;
+        float p = 0;
+
+        SERIALIZE(
+            STORE(&Numbers::a, "a"), STORE(&Numbers::b, "b"), STORE(&Numbers::c, "c"), STORE(&Numbers::d, "d"),
+            STORE(&Numbers::e, "e"), STORE(&Numbers::f, "f"), STORE(&Numbers::g, "g"), STORE(&Numbers::h, "h"),
+            STORE(&Numbers::i, "i"), STORE(&Numbers::j, "j"), STORE(&Numbers::k, "k"), STORE(&Numbers::l, "l"),
+            STORE(&Numbers::m, "m"), STORE(&Numbers::n, "n"), STORE(&Numbers::o, "o"), STORE(&Numbers::p, "p")
+        );
+
+        static Numbers make(Random& random)
+        {
+            Numbers numbers;
+            for(double* value : { &numbers.a, &numbers.b, &numbers.c, &numbers.d, &numbers.e, &numbers.f, &numbers.g, &numbers.h })
+            {
+                *value = static_cast<double>(random.next()) / static_cast<double>(random.next() | 1);
+            }
+            for(std::int64_t* value : { &numbers.i, &numbers.j, &numbers.k, &numbers.l })
+            {
+                *value = static_cast<std::int64_t>(random.next()) - (1LL << 45);
+            }
+            numbers.m = static_cast<std::uint32_t>(random.next());
+            numbers.n = static_cast<std::uint32_t>(random.next() % 1000);
+            numbers.o = static_cast<std::int8_t>(random.next());
+            numbers.p = static_cast<float>(random.next()) / 3.0f;
+            return numbers;
+        }
+    };
+
+    struct Containers
+    {
+        std::vector<int> ids;
+        std::vector<double> samples;
+        std::vector<std::string> tags;
+        std::vector<Human> members;
+        std::map<std::string, int> counts;
+
+        SERIALIZE(
+            STORE(&Containers::ids, "ids"),
+            STORE(&Containers::samples, "samples"),
+            STORE(&Containers::tags, "tags"),
+            STORE(&Containers::members, "members"),
+            STORE(&Containers::counts, "counts")
+        );
+
+        static Containers make(Random& random)
+        {
+            Containers containers;
+            for(int i = 0; i < 100; i++)
+            {
+                containers.ids.push_back(static_cast<int>(random.next()));
+                containers.samples.push_back(static_cast<double>(random.next()) / 1e6);
+            }
+            for(int i = 0; i < 20; i++)
+            {
+                containers.tags.push_back(random.text(10));
+                containers.members.push_back(Human::make(random));
+                containers.counts[random.text(6)] = static_cast<int>(random.next() % 1000);
+            }
+            return containers;
+        }
+    };
+
+    /**
+     * A time series of flat records, stored column by column.
+     */
+    struct Series
+    {
+        serialization::Columns<Flat> records;
+
+        SERIALIZE(
+            STORE(&Series::records, "records")
+        );
+
+        static Series make(Random& random)
+        {
+            Series series;
+            for(int i = 0; i < 100; i++)
+            {
+                series.records.push_back(Flat::make(random));
+            }
+            return series;
+        }
+    };
+
+    /**
+     * Mostly increasing timestamps and small counters, stored with the Delta codec.
+     */
+    struct Timeline
+    {
+        std::vector<std::int64_t> timestamps;
+        std::vector<std::uint32_t> counts;
+
+        SERIALIZE(
+            STORE_AS(&Timeline::timestamps, "timestamps", serialization::Delta),
+            STORE_AS(&Timeline::counts, "counts", serialization::Delta)
+        );
+
+        static Timeline make(Random& random)
+        {
+            Timeline timeline;
+            std::int64_t time = 1600000000000;
+            for(int i = 0; i < 1000; i++)
+            {
+                time += static_cast<std::int64_t>(random.next() % 1000);
+                timeline.timestamps.push_back(time);
+                timeline.counts.push_back(static_cast<std::uint32_t>(random.next() % 64));
+            }
+            return timeline;
+        }
+    };
+}
+
+/** ARCHIVES */
+template<typename Archive>
+struct ArchiveTraits;
+
+template<>
+struct ArchiveTraits<serialization::archive::JsonArchive>
+{
+    static constexpr const char* name = "json";
+
+    static std::string bytes(const serialization::archive::JsonArchive& archive)
+    {
+        return std::string(archive.getText());
+    }
+    static std::size_t size(const serialization::archive::JsonArchive& archive)
+    {
+        return archive.getText().size();
+    }
+    static serialization::archive::JsonArchive load(const std::string& bytes)
+    {
+        serialization::archive::JsonArchive archive;
+        archive.setText(bytes);
+        return archive;
+    }
+};
+
+template<>
+struct ArchiveTraits<serialization::archive::BinaryArchive>
+{
+    static constexpr const char* name = "binary";
+
+    static std::string bytes(const serialization::archive::BinaryArchive& archive)
+    {
+        return archive.getStorage();
+    }
+    static std::size_t size(const serialization::archive::BinaryArchive& archive)
+    {
+        return archive.getStorage().size();
+    }
+    static serialization::archive::BinaryArchive load(const std::string& bytes)
+    {
+        return serialization::archive::BinaryArchive::view(bytes);
+    }
+};
+
+/** HARNESS */
+struct Measurement
+{
+    double seconds;
+    double allocationsPerOperation;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+};
+
+template<typename Operation>
+Measurement measure(std::size_t iterations, Operation&& operation)
+{
+    using Clock = std::chrono::steady_clock;
+    for(std::size_t i = 0; i < iterations / 10 + 1; i++)
+    {
+        operation();
+    }
+
+    std::vector<double> latencies(iterations);
+    const std::size_t allocationsBefore = allocations;
+    const Clock::time_point begin = Clock::now();
+    for(std::size_t i = 0; i < iterations; i++)
+    {
+        const Clock::time_point start = Clock::now();
+        operation();
+        latencies[i] = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    const std::size_t allocated = allocations - allocationsBefore;
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p)
+    {
+        return latencies[std::min(latencies.size() - 1, static_cast<std::size_t>(p * static_cast<double>(latencies.size())))];
+    };
+    return Measurement { seconds, static_cast<double>(allocated) / static_cast<double>(iterations), percentile(0.5), percentile(0.9), percentile(0.99), latencies.back() };
+}
+
+void report(const char* archive, const char* shape, const char* operation, std::size_t iterations, std::size_t bytes, const Measurement& measurement)
+{
+    std::printf("{\"archive\":\"%s\",\"shape\":\"%s\",\"operation\":\"%s\",\"iterations\":%zu,\"bytes\":%zu,"
+                "\"mb_per_s\":%.2f,\"objects_per_s\":%.0f,\"p50_ns\":%.0f,\"p90_ns\":%.0f,\"p99_ns\":%.0f,\"max_ns\":%.0f,"
+                "\"allocations_per_op\":%.2f}\n",
+        archive, shape, operation, iterations, bytes,
+        static_cast<double>(bytes) * static_cast<double>(iterations) / measurement.seconds / 1e6,
+        static_cast<double>(iterations) / measurement.seconds,
+        measurement.p50, measurement.p90, measurement.p99, measurement.max,
+        measurement.allocationsPerOperation);
+    std::fflush(stdout);
+}
+
+/** Keeps results alive, so the compiler can not drop the measured work. */
+volatile std::size_t sink = 0;
+
+template<typename Archive, typename T>
+void run(const char* shape, std::size_t iterations, const std::string& filter)
+{
+    using Traits = ArchiveTraits<Archive>;
+    if((std::string(Traits::name) + "/" + shape).find(filter) == std::string::npos)
+    {
+        return;
+    }
+
+    shapes::Random random(42);
+    const T object = T::make(random);
+    const std::string bytes = Traits::bytes(serialization::serialize<Archive>(object));
+
+    const Measurement serializing = measure(iterations, [&]()
+    {
+        const Archive archive = serialization::serialize<Archive>(object);
+        sink = sink + Traits::size(archive);
+    });
+    report(Traits::name, shape, "serialize", iterations, bytes.size(), serializing);
+
+    const Measurement deserializing = measure(iterations, [&]()
+    {
+        const Archive archive = Traits::load(bytes);
+        T result;
+        serialization::deserialize<Archive>(archive, result);
+        sink = sink + 1;
+    });
+    report(Traits::name, shape, "deserialize", iterations, bytes.size(), deserializing);
+}
+
+/**
+ * Measures serializeBatch and deserializeBatch of BATCH objects, indexed in chunks of BATCH_CHUNK.
+ */
+constexpr std::size_t BATCH = 100;
+constexpr std::size_t BATCH_CHUNK = 25;
+
+template<typename T>
+void runBatch(const char* shape, std::size_t iterations, const std::string& filter)
+{
+    using Archive = serialization::archive::BinaryArchive;
+    using Traits = ArchiveTraits<Archive>;
+    const std::string name = std::string(shape) + "_batch";
+    if((std::string(Traits::name) + "/" + name).find(filter) == std::string::npos)
+    {
+        return;
+    }
+
+    shapes::Random random(42);
+    std::vector<T> objects;
+    for(std::size_t i = 0; i < BATCH; i++)
+    {
+        objects.push_back(T::make(random));
+    }
+    const std::string bytes = Traits::bytes(serialization::serializeBatch<Archive>(objects, BATCH_CHUNK));
+
+    const Measurement serializing = measure(iterations, [&]()
+    {
+        const Archive archive = serialization::serializeBatch<Archive>(objects, BATCH_CHUNK);
+        sink = sink + Traits::size(archive);
+    });
+    report(Traits::name, name.c_str(), "serialize", iterations, bytes.size(), serializing);
+
+    std::vector<T> result;
+    const Measurement deserializing = measure(iterations, [&]()
+    {
+        const Archive archive = Traits::load(bytes);
+        serialization::deserializeBatch(archive, result, 1);
+        sink = sink + result.size();
+    });
+    report(Traits::name, name.c_str(), "deserialize", iterations, bytes.size(), deserializing);
+}
+
+/**
+ * Measures compress and decompress of the binary batch of a shape. bytes is the size before compression.
+ */
+template<typename T>
+void runCompression(const char* codec, serialization::Compression compression, const char* shape, std::size_t iterations, const std::string& filter)
+{
+    if((std::string(codec) + "/" + shape).find(filter) == std::string::npos)
+    {
+        return;
+    }
+
+    shapes::Random random(42);
+    std::vector<T> objects;
+    for(std::size_t i = 0; i < BATCH; i++)
+    {
+        objects.push_back(T::make(random));
+    }
+    const std::string bytes = serialization::serializeBatch<serialization::archive::BinaryArchive>(objects).getStorage();
+    const std::string packed = serialization::compress(bytes, compression);
+
+    const Measurement compressing = measure(iterations, [&]()
+    {
+        sink = sink + serialization::compress(bytes, compression).size();
+    });
+    report(codec, shape, "compress", iterations, bytes.size(), compressing);
+
+    const Measurement decompressing = measure(iterations, [&]()
+    {
+        sink = sink + serialization::decompress(packed).size();
+    });
+    report(codec, shape, "decompress", iterations, bytes.size(), decompressing);
+}
+
+template<typename Archive>
+void runShapes(std::size_t iterations, const std::string& filter)
+{
+    run<Archive, shapes::Flat>("flat", iterations, filter);
+    run<Archive, shapes::Nested>("nested", iterations, filter);
+    run<Archive, shapes::Strings>("strings", iterations, filter);
+    run<Archive, shapes::Numbers>("numbers", iterations, filter);
+    run<Archive, shapes::Containers>("containers", iterations, filter);
+    run<Archive, shapes::Series>("series", iterations, filter);
+    run<Archive, shapes::Timeline>("timeline", iterations, filter);
+}
+
+int main(int argc, char** argv)
+{
+    const std::size_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+    const std::string filter = argc > 2 ? argv[2] : "";
+    if(iterations == 0)
+    {
+        std::fprintf(stderr, "usage: %s [iterations] [filter]\n", argv[0]);
+        return 1;
+    }
+
+    runShapes<serialization::archive::JsonArchive>(iterations, filter);
+    runShapes<serialization::archive::BinaryArchive>(iterations, filter);
+
+    runBatch<shapes::Flat>("flat", iterations, filter);
+    runBatch<shapes::Strings>("strings", iterations, filter);
+    runBatch<shapes::Containers>("containers", iterations, filter);
+
+    runCompression<shapes::Strings>("lz", serialization::Compression::Lz, "strings", iterations, filter);
+    runCompression<shapes::Containers>("lz", serialization::Compression::Lz, "containers", iterations, filter);
+#if defined(SERIALIZATION_ZSTD)
+    runCompression<shapes::Strings>("zstd", serialization::Compression::Zstd, "strings", iterations, filter);
+    runCompression<shapes::Containers>("zstd", serialization::Compression::Zstd, "containers", iterations, filter);
+#endif
+    return 0;
+}
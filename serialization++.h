@@ -5,6 +5,55 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <memory>
+#include <charconv>
+#include <limits>
+#include <cmath>
+#include <array>
+#include <optional>
+#include <typeindex>
+#include <unordered_map>
+#include <iterator>
+#include <chrono>
+#include <filesystem>
+
+/** SIMD SUPPORT */
+#if !defined(SERIALIZATION_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__))
+#define SERIALIZATION_SSE2
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+/** Functions marked with this are compiled for AVX2 and only called after a runtime check. */
+#define SERIALIZATION_AVX2 __attribute__((target("avx2")))
+#if defined(__x86_64__)
+/** The same for the crc32 instruction of SSE4.2. */
+#define SERIALIZATION_SSE42 __attribute__((target("sse4.2")))
+#endif
+#endif
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/** COMPRESSION */
+#if defined(SERIALIZATION_ZSTD)
+#include <zstd.h>
+#endif
+
+/** INSTRUMENTATION */
+#if defined(SERIALIZATION_INSTRUMENTATION)
+#include <typeinfo>
+#include <map>
+#endif
 
 /** DEPENDENCIES */
 #include "json.hpp"
@@ -15,20 +64,260 @@
 /** Returns true if T has the PROPERTIES attribute. */
 #define IF_SERIALIZABLE(T, RETURN_TYPE) std::enable_if_t<serialization::detail::has_properties<T>::value, RETURN_TYPE>
 #define IF_NOT_SERIALIZABLE(T, RETURN_TYPE) std::enable_if_t<!serialization::detail::has_properties<T>::value, RETURN_TYPE>
+/** Returns true if T is an iterable container other than std::string, a std::pair, or any other value. */
+#define IF_CONTAINER(T, RETURN_TYPE) std::enable_if_t<serialization::detail::value_category<T>::value == serialization::detail::Category::Container, RETURN_TYPE>
+#define IF_PAIR(T, RETURN_TYPE) std::enable_if_t<serialization::detail::value_category<T>::value == serialization::detail::Category::Pair, RETURN_TYPE>
+#define IF_SCALAR(T, RETURN_TYPE) std::enable_if_t<serialization::detail::value_category<T>::value == serialization::detail::Category::Scalar, RETURN_TYPE>
+/** Returns true if T is a std::unique_ptr to a polymorphic type. */
+#define IF_POINTER(T, RETURN_TYPE) std::enable_if_t<serialization::detail::value_category<T>::value == serialization::detail::Category::Pointer, RETURN_TYPE>
+/** Returns true if T is a std::shared_ptr, whose objects are stored once per archive. */
+#define IF_SHARED(T, RETURN_TYPE) std::enable_if_t<serialization::detail::value_category<T>::value == serialization::detail::Category::Shared, RETURN_TYPE>
+/** Returns true if T is a Cached property. */
+#define IF_CACHED(T, RETURN_TYPE) std::enable_if_t<serialization::detail::value_category<T>::value == serialization::detail::Category::Cached, RETURN_TYPE>
+/** Returns true if T is a Columns property, whose records are stored column by column. */
+#define IF_COLUMNS(T, RETURN_TYPE) std::enable_if_t<serialization::detail::value_category<T>::value == serialization::detail::Category::Columns, RETURN_TYPE>
 /** Definitions for easier serialization. */
 #define SERIALIZE(...) constexpr static auto PROPERTIES = std::make_tuple(__VA_ARGS__)
+/** Like SERIALIZE, but the properties of BASE come first, so a subclass only lists its own. */
+#define SERIALIZE_BASE(BASE, ...) constexpr static auto PROPERTIES = std::tuple_cat(BASE::PROPERTIES, std::make_tuple(__VA_ARGS__))
 #define STORE(x,y) serialization::detail::makeProperty(x, y)
+/** Like STORE, but the archive encodes the property with CODEC, eg. STORE_AS(&Log::times, "times", serialization::Delta). */
+#define STORE_AS(x,y,CODEC) serialization::detail::makeProperty<CODEC>(x, y)
+/** Stores an enum by name instead of by value. The names have to be listed in the order of the values 0, 1, 2... */
+#define SERIALIZE_ENUM(ENUM, ...) namespace serialization { template<> struct enum_names<ENUM> { static constexpr const char* names[] = { __VA_ARGS__ }; }; }
 
 
 /** http://ideone.com/yd0dhs */
 namespace serialization
 {
+    /**
+     * Specialize this (or use SERIALIZE_ENUM) to store an enum by name. names[i] is the name of the value i.
+     */
+    template<typename Enum>
+    struct enum_names
+    {
+    };
+
+    /**
+     * Selects the properties storing members, eg. deserialize<Archive>(archive, human, fields<&Human::name>).
+     */
+    template<auto... members>
+    struct Fields
+    {
+    };
+    template<auto... members>
+    inline constexpr Fields<members...> fields {};
+
+    /**
+     * Codec for integers that mostly increase, like timestamps and ids. A container of them, or a column of them
+     * in Columns, is stored as its first value followed by the bit-packed differences between neighbours.
+     * Archives without an encoding for a codec store the property as usual.
+     */
+    struct Delta
+    {
+    };
+
+    /**
+     * How files and buffers are compressed. Lz is built in, Zstd needs SERIALIZATION_ZSTD and linking libzstd.
+     */
+    enum class Compression
+    {
+        None,
+        Lz,
+        Zstd
+    };
+
+    enum class Checksum
+    {
+        None,
+        Crc32c
+    };
+
+    template<typename T>
+    class Cached;
+
+    template<typename T>
+    class Columns;
+
+    /**
+     * Derive from Trackable to record which properties were written through set or markDirty, so that
+     * serializeDirty stores only those. Property i is bit i of the mask, so types with up to 64 properties can be
+     * tracked.
+     */
+    class Trackable
+    {
+    private:
+        std::uint64_t dirty = 0;
+
+    public:
+        bool isDirty() const
+        {
+            return dirty != 0;
+        }
+        bool isDirty(std::size_t property) const
+        {
+            return property < 64 && ((dirty >> property) & 1);
+        }
+        void setDirty(std::size_t property)
+        {
+            if(property >= 64)
+            {
+                throw std::out_of_range("Trackable: only the first 64 properties can be tracked");
+            }
+            dirty |= std::uint64_t(1) << property;
+        }
+        void clearDirty()
+        {
+            dirty = 0;
+        }
+    };
+
+#if defined(SERIALIZATION_INSTRUMENTATION)
+    /**
+     * Reports what serializing costs, per type and per property, to a registered Sink. Only compiled in if
+     * SERIALIZATION_INSTRUMENTATION is defined, otherwise nothing is measured.
+     */
+    namespace instrumentation
+    {
+        enum class Operation
+        {
+            Serialize,
+            Deserialize
+        };
+
+        struct Event
+        {
+            Operation operation;
+            /** typeid(T).name() of the object. */
+            const char* type;
+            /** The name of the property, or nullptr for a whole object passed to serialize or deserialize. */
+            const char* field;
+            /** Bytes written or read. */
+            std::size_t bytes;
+            std::uint64_t nanoseconds;
+            /** Allocations counted by the AllocationCounter, 0 if there is none. */
+            std::size_t allocations;
+        };
+
+        /**
+         * Receives one Event per property and per object. Batches decode on several threads, so record has to be
+         * thread-safe.
+         */
+        class Sink
+        {
+        public:
+            virtual ~Sink() = default;
+            virtual void record(const Event& event) = 0;
+        };
+
+        /**
+         * Returns the number of allocations made so far, usually counted by a replaced operator new.
+         */
+        using AllocationCounter = std::size_t (*)();
+
+        inline std::atomic<Sink*> sink { nullptr };
+        inline std::atomic<AllocationCounter> allocationCounter { nullptr };
+
+        /**
+         * Registers the sink events are reported to, nullptr stops reporting.
+         */
+        inline void setSink(Sink* aSink)
+        {
+            sink = aSink;
+        }
+        inline void setAllocationCounter(AllocationCounter counter)
+        {
+            allocationCounter = counter;
+        }
+
+        /**
+         * A Sink that sums up the events per operation, type and field.
+         */
+        class Statistics : public Sink
+        {
+        public:
+            struct Totals
+            {
+                std::size_t calls = 0;
+                std::size_t bytes = 0;
+                std::uint64_t nanoseconds = 0;
+                std::size_t allocations = 0;
+            };
+            /** Operation, type and field, which is empty for whole objects. */
+            using Key = std::tuple<Operation, std::string, std::string>;
+
+            void record(const Event& event) override
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                Totals& total = totals[Key(event.operation, event.type, event.field ? event.field : "")];
+                total.calls++;
+                total.bytes += event.bytes;
+                total.nanoseconds += event.nanoseconds;
+                total.allocations += event.allocations;
+            }
+            std::map<Key, Totals> snapshot() const
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                return totals;
+            }
+            void clear()
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                totals.clear();
+            }
+
+        private:
+            mutable std::mutex mutex;
+            std::map<Key, Totals> totals;
+        };
+
+        /**
+         * Measures from construction until report. Does nothing if no sink is registered.
+         */
+        class Measurement
+        {
+        private:
+            Sink* target;
+            std::size_t offset;
+            std::size_t allocations = 0;
+            std::chrono::steady_clock::time_point start;
+
+        public:
+            explicit Measurement(std::size_t aOffset)
+            : target(sink), offset(aOffset)
+            {
+                if(target)
+                {
+                    const AllocationCounter counter = allocationCounter;
+                    allocations = counter ? counter() : 0;
+                    start = std::chrono::steady_clock::now();
+                }
+            }
+            void report(Operation operation, const char* type, const char* field, std::size_t end) const
+            {
+                if(!target)
+                {
+                    return;
+                }
+                const auto elapsed = std::chrono::steady_clock::now() - start;
+                const AllocationCounter counter = allocationCounter;
+                target->record(Event {
+                    operation, type, field,
+                    end > offset ? end - offset : 0,
+                    static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()),
+                    counter ? counter() - allocations : 0
+                });
+            }
+        };
+    }
+#endif
+
     /**
      * The detail-namespace contains everything that should be hidden to the outside world.
      */
     namespace detail
     {
-        template<typename Class, typename T>
+        template<typename Class, typename T, typename C = void>
         struct Property
         {
             constexpr Property(T Class::*aMember, const char* aName)
@@ -37,14 +326,44 @@ namespace serialization
                 // empty
             }
             using Type = T;
+            /** The codec the property is stored with, void if none was chosen. */
+            using Codec = C;
             T Class::*member;
             const char* name;
         };
 
-        template<typename Class, typename T>
+        template<typename Codec = void, typename Class, typename T>
         constexpr auto makeProperty(T Class::*member, const char* name)
         {
-            return serialization::detail::Property<Class, T>{member, name};
+            return serialization::detail::Property<Class, T, Codec>{member, name};
+        }
+
+        /**
+         * Stores and retrieves the value of a property, passing its codec to the archive if it has one.
+         */
+        template<typename Definition, typename IArchive>
+        void storeProperty(IArchive& archive, const Definition& property, const typename Definition::Type& value)
+        {
+            if constexpr(std::is_void<typename Definition::Codec>::value)
+            {
+                archive.template store<typename Definition::Type>(property.name, value);
+            }
+            else
+            {
+                archive.template store<typename Definition::Type>(property.name, value, typename Definition::Codec());
+            }
+        }
+        template<typename Definition, typename IArchive>
+        typename Definition::Type retrieveProperty(const IArchive& archive, const Definition& property)
+        {
+            if constexpr(std::is_void<typename Definition::Codec>::value)
+            {
+                return archive.template retrieve<typename Definition::Type>(property.name);
+            }
+            else
+            {
+                return archive.template retrieve<typename Definition::Type>(property.name, typename Definition::Codec());
+            }
         }
 
         /**
@@ -54,6 +373,13 @@ namespace serialization
         struct has_properties : std::false_type { };
         template<typename T>
         struct has_properties<T, decltype((T::PROPERTIES), void())> : std::true_type { };
+        /**
+         * Used to check if an enum has names to be stored with.
+         */
+        template<typename T, typename = void>
+        struct has_enum_names : std::false_type { };
+        template<typename T>
+        struct has_enum_names<T, decltype((serialization::enum_names<T>::names), void())> : std::true_type { };
         /**
          * Used to check if a Type is a std::pair.
          */
@@ -77,227 +403,5626 @@ namespace serialization
         };
 
         /**
-         * DESERIALIZATION HELPER FUNCTIONS *
+         * Used to check if a Type is a Cached property.
          */
-        template<std::size_t iteration, typename T, typename IArchive>
-        void doSetData(T&& object, const IArchive& archive)
+        template<typename T>
+        struct is_cached : std::false_type { };
+        template<typename T>
+        struct is_cached<Cached<T>> : std::true_type { };
+        /**
+         * Used to check if a Type is a Columns property.
+         */
+        template<typename T>
+        struct is_columns : std::false_type { };
+        template<typename T>
+        struct is_columns<Columns<T>> : std::true_type { };
+        /**
+         * Used to check if a Type is a std::unique_ptr to a polymorphic type, which is stored with its type id.
+         */
+        template<typename T>
+        struct is_polymorphic_pointer : std::false_type { };
+        template<typename T>
+        struct is_polymorphic_pointer<std::unique_ptr<T>> : std::is_polymorphic<T> { };
+        /**
+         * Used to check if a Type is a std::shared_ptr.
+         */
+        template<typename T>
+        struct is_shared_pointer : std::false_type { };
+        template<typename T>
+        struct is_shared_pointer<std::shared_ptr<T>> : std::true_type { };
+
+        /**
+         * Archives encode a value depending on which of these it is.
+         */
+        enum class Category
         {
-            constexpr auto property = std::get<iteration>(std::decay_t<T>::PROPERTIES);
-            using Type = typename decltype(property)::Type;
-            object.*(property.member) = archive.template retrieve<Type>(property.name);
-        }
+            Serializable,
+            Container,
+            Pair,
+            Scalar,
+            Cached,
+            Pointer,
+            Shared,
+            Columns
+        };
+        template<typename T>
+        struct value_category : std::integral_constant<Category,
+            has_properties<T>::value ? Category::Serializable :
+            is_cached<T>::value ? Category::Cached :
+            is_polymorphic_pointer<T>::value ? Category::Pointer :
+            is_shared_pointer<T>::value ? Category::Shared :
+            is_columns<T>::value ? Category::Columns :
+            std::is_same<T, std::string>::value ? Category::Scalar :
+            is_iterable<T>::value ? Category::Container :
+            is_pair<T>::value ? Category::Pair :
+            Category::Scalar> { };
 
         /**
-         * If iteration == 0, stop iterating.
+         * Whether a value of T can hold a std::shared_ptr. Its object has to be read even when the value is skipped,
+         * as later references may point to it. Objects behind a std::unique_ptr can have any registered type, so
+         * they count as well. Visited holds the objects searched already, which ends the search for types that
+         * contain themselves.
          */
-        template<std::size_t iteration, typename T, typename IArchive>
-        std::enable_if_t<(iteration <= 0)>
-        setData(T&& object, const IArchive& archive)
+        template<typename T, typename Visited = std::tuple<>>
+        constexpr bool holdsShared();
+
+        template<typename T, typename... Types>
+        constexpr bool isVisited(std::tuple<Types...>*)
         {
-            serialization::detail::doSetData<iteration, T, IArchive>(object, archive);
+            return (std::is_same<T, Types>::value || ...);
+        }
+
+        template<typename T, typename Visited, std::size_t... indices>
+        constexpr bool propertiesHoldShared(std::index_sequence<indices...>)
+        {
+            using Next = decltype(std::tuple_cat(std::declval<Visited>(), std::declval<std::tuple<T>>()));
+            return (serialization::detail::holdsShared<typename std::tuple_element_t<indices, std::decay_t<decltype(T::PROPERTIES)>>::Type, Next>() || ...);
+        }
+
+        template<typename T, typename Visited>
+        constexpr bool holdsShared()
+        {
+            constexpr Category category = value_category<T>::value;
+            if constexpr(category == Category::Shared || category == Category::Pointer)
+            {
+                return true;
+            }
+            else if constexpr(category == Category::Serializable)
+            {
+                if constexpr(serialization::detail::isVisited<T>(static_cast<Visited*>(nullptr)))
+                {
+                    return false;
+                }
+                else
+                {
+                    return serialization::detail::propertiesHoldShared<T, Visited>(std::make_index_sequence<std::tuple_size<std::decay_t<decltype(T::PROPERTIES)>>::value>());
+                }
+            }
+            else if constexpr(category == Category::Columns)
+            {
+                return serialization::detail::holdsShared<typename T::value_type, Visited>();
+            }
+            else if constexpr(category == Category::Cached)
+            {
+                return serialization::detail::holdsShared<typename T::Type, Visited>();
+            }
+            else if constexpr(category == Category::Container)
+            {
+                return serialization::detail::holdsShared<std::remove_const_t<typename T::value_type>, Visited>();
+            }
+            else if constexpr(category == Category::Pair)
+            {
+                return serialization::detail::holdsShared<std::remove_const_t<typename T::first_type>, Visited>()
+                    || serialization::detail::holdsShared<typename T::second_type, Visited>();
+            }
+            else
+            {
+                return false;
+            }
         }
 
         /**
-         * If iteration > 0, continue iterating.
+         * Reserves space in containers that support it, but never more than limit elements.
          */
-        template<std::size_t iteration, typename T, typename IArchive>
-        std::enable_if_t<(iteration > 0)>
-        setData(T&& object, const IArchive& archive)
+        template<typename T>
+        auto reserve(T& container, std::size_t count, std::size_t limit, int) -> decltype(container.reserve(count), void())
         {
-            serialization::detail::doSetData<iteration, T, IArchive>(object, archive);
-            serialization::detail::setData<(iteration - 1), T, IArchive>(object, archive);
+            container.reserve(std::min(count, limit));
+        }
+        template<typename T>
+        void reserve(T&, std::size_t, std::size_t, long)
+        {
+            // empty
+        }
+        template<typename T>
+        void reserve(T& container, std::size_t count, std::size_t limit)
+        {
+            serialization::detail::reserve(container, count, limit, 0);
         }
 
         /**
-         * SERIALIZATION HELPER FUNCTIONS *
+         * DESERIALIZATION HELPER FUNCTIONS *
          */
         template<std::size_t iteration, typename T, typename IArchive>
-        void doGetData(T&& object, IArchive& archive)
+        void doSetData(T&& object, const IArchive& archive)
         {
             constexpr auto property = std::get<iteration>(std::decay_t<T>::PROPERTIES);
-            using Type = typename decltype(property)::Type;
-            archive.template store<Type>(property.name, object.*(property.member));
+#if defined(SERIALIZATION_INSTRUMENTATION)
+            const instrumentation::Measurement measurement(archive.bytesRead());
+#endif
+            object.*(property.member) = serialization::detail::retrieveProperty(archive, property);
+#if defined(SERIALIZATION_INSTRUMENTATION)
+            measurement.report(instrumentation::Operation::Deserialize, typeid(std::decay_t<T>).name(), property.name, archive.bytesRead());
+#endif
         }
 
         /**
-         * If iteration == 0, stop iterating.
+         * If all properties have been visited, stop iterating.
          */
         template<std::size_t iteration, typename T, typename IArchive>
-        std::enable_if_t<(iteration <= 0)>
-        getData(T&& object, IArchive& archive)
+        std::enable_if_t<(iteration >= std::tuple_size<decltype(std::decay_t<T>::PROPERTIES)>::value)>
+        setData(T&&, const IArchive&)
         {
-            serialization::detail::doGetData<iteration, T, IArchive>(object, archive);
+            // empty
         }
 
         /**
-         * If iteration > 0, continue iterating.
+         * Properties are visited in declaration order, so that sequential archives lay them out that way.
          */
         template<std::size_t iteration, typename T, typename IArchive>
-        std::enable_if_t<(iteration > 0)>
-        getData(T&& object, IArchive& archive)
+        std::enable_if_t<(iteration < std::tuple_size<decltype(std::decay_t<T>::PROPERTIES)>::value)>
+        setData(T&& object, const IArchive& archive)
         {
-            serialization::detail::doGetData<iteration, T, IArchive>(object, archive);
-            serialization::detail::getData<(iteration - 1), T, IArchive>(object, archive);
+            serialization::detail::doSetData<iteration, T, IArchive>(object, archive);
+            serialization::detail::setData<(iteration + 1), T, IArchive>(object, archive);
         }
-    }
 
-    /**
-     * Takes an IArchive and writes the contained properties to the object. Object has to have
-     * the SERIALIZATION-macro.
-     */
-    template<typename IArchive, typename T>
-    bool deserialize(const IArchive& archive, T &obj)
-    {
-        detail::setData<(std::tuple_size<decltype(T::PROPERTIES)>::value - 1)>(obj, archive);
-        return true;
-    };
+        /**
+         * Returns the position of the property storing member in T::PROPERTIES, or their count if there is none.
+         */
+        template<typename T, std::size_t iteration = 0, typename Member>
+        constexpr std::size_t propertyIndex(Member member)
+        {
+            constexpr std::size_t count = std::tuple_size<decltype(T::PROPERTIES)>::value;
+            if constexpr(iteration >= count)
+            {
+                return count;
+            }
+            else
+            {
+                constexpr auto property = std::get<iteration>(T::PROPERTIES);
+                if constexpr(std::is_same<decltype(property.member), Member>::value)
+                {
+                    if(property.member == member)
+                    {
+                        return iteration;
+                    }
+                }
+                return serialization::detail::propertyIndex<T, (iteration + 1)>(member);
+            }
+        }
 
-    /**
-     * Takes an object with the SERIALIZE-macro and stores it's properties in an IArchive.
-     */
-    template<typename IArchive, typename T>
-    IArchive serialize(const T &obj)
-    {
-        IArchive archive;
-        detail::getData<(std::tuple_size<decltype(T::PROPERTIES)>::value - 1)>(obj, archive);
-        return archive;
-    }
+        /**
+         * The type of the property storing member in T::PROPERTIES.
+         */
+        template<typename T, auto member>
+        using property_type = typename std::tuple_element<propertyIndex<T>(member), std::decay_t<decltype(T::PROPERTIES)>>::type::Type;
 
+        template<typename T, std::size_t iteration, auto... members>
+        constexpr bool isSelected(Fields<members...>)
+        {
+            return ((serialization::detail::propertyIndex<T>(members) == iteration) || ...);
+        }
 
-    /**
-     * The archive-namespace contains different Archive implementations, to store object in to different formats.
-     */
-    namespace archive
-    {
-        class IArchive
+        /**
+         * Like setData, but skips the properties not in Selection instead of decoding them.
+         */
+        template<std::size_t iteration, typename Selection, typename T, typename IArchive>
+        std::enable_if_t<(iteration >= std::tuple_size<decltype(T::PROPERTIES)>::value)>
+        setFields(T&, const IArchive&)
         {
-        public:
-            virtual bool saveToFile(const std::string& filepath) = 0;
-            virtual bool loadFromFile(const std::string& filepath) = 0;
-        };
+            // empty
+        }
 
-        class JsonArchive : public IArchive
+        template<std::size_t iteration, typename Selection, typename T, typename IArchive>
+        std::enable_if_t<(iteration < std::tuple_size<decltype(T::PROPERTIES)>::value)>
+        setFields(T& object, const IArchive& archive)
         {
-        private:
-            json::JSON storage;
-        public:
-            json::JSON getStorage()
+            if constexpr(serialization::detail::isSelected<T, iteration>(Selection()))
             {
-                return storage;
+                serialization::detail::doSetData<iteration>(object, archive);
             }
-            void setStorage(const json::JSON aStorage)
+            else
             {
-                storage = aStorage;
+                constexpr auto property = std::get<iteration>(T::PROPERTIES);
+                archive.template skip<typename decltype(property)::Type>(property.name);
             }
+            serialization::detail::setFields<(iteration + 1), Selection>(object, archive);
+        }
 
-            bool saveToFile(const std::string& filepath) override
-            {
-                std::ofstream file(filepath);
-                file << storage;
-                file.close();
-                return true;
-            }
-            bool loadFromFile(const std::string& filepath) override
-            {
-                std::ifstream file(filepath);
-                std::string fileContents { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
-                storage = json::JSON::Load(fileContents);
-                return true;
-            }
+        template<typename Base>
+        struct PolymorphicTypes;
 
+        /**
+         * Compares two values property by property and element by element.
+         */
+        template<typename T>
+        IF_SERIALIZABLE(T, bool) equal(const T& a, const T& b);
+        template<typename T>
+        IF_CONTAINER(T, bool) equal(const T& a, const T& b);
+        template<typename T>
+        IF_PAIR(T, bool) equal(const T& a, const T& b);
+        template<typename T>
+        IF_SCALAR(T, bool) equal(const T& a, const T& b);
+        template<typename T>
+        IF_CACHED(T, bool) equal(const T& a, const T& b);
+        template<typename T>
+        IF_POINTER(T, bool) equal(const T& a, const T& b);
+        template<typename T>
+        IF_SHARED(T, bool) equal(const T& a, const T& b);
+        template<typename T>
+        IF_COLUMNS(T, bool) equal(const T& a, const T& b);
 
-            // template<typename T>
-            // IS_STL_CONTAINER(T, void) store(const char* name, const T& value);
+        template<typename T, std::size_t... indices>
+        bool equalProperties(const T& a, const T& b, std::index_sequence<indices...>)
+        {
+            return (serialization::detail::equal(a.*(std::get<indices>(T::PROPERTIES).member), b.*(std::get<indices>(T::PROPERTIES).member)) && ...);
+        }
 
-            template<typename T>
-            IF_SERIALIZABLE(T, void) store(const char* name, const T& value);
+        template<typename T>
+        IF_SERIALIZABLE(T, bool) equal(const T& a, const T& b)
+        {
+            return serialization::detail::equalProperties(a, b, std::make_index_sequence<std::tuple_size<decltype(T::PROPERTIES)>::value>());
+        }
+        template<typename T>
+        IF_CONTAINER(T, bool) equal(const T& a, const T& b)
+        {
+            return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const auto& x, const auto& y)
+            {
+                return serialization::detail::equal(x, y);
+            });
+        }
+        template<typename T>
+        IF_PAIR(T, bool) equal(const T& a, const T& b)
+        {
+            return serialization::detail::equal(a.first, b.first) && serialization::detail::equal(a.second, b.second);
+        }
+        template<typename T>
+        IF_SCALAR(T, bool) equal(const T& a, const T& b)
+        {
+            return a == b;
+        }
+        template<typename T>
+        IF_CACHED(T, bool) equal(const T& a, const T& b)
+        {
+            return serialization::detail::equal(a.get(), b.get());
+        }
+        /**
+         * Objects behind pointers are equal if they have the same registered type and equal properties.
+         */
+        template<typename T>
+        IF_POINTER(T, bool) equal(const T& a, const T& b)
+        {
+            if(!a || !b)
+            {
+                return !a && !b;
+            }
+            return serialization::detail::PolymorphicTypes<typename T::element_type>::get().equal(*a, *b);
+        }
+        /**
+         * Shared objects are compared by identity, as their graph may have cycles.
+         */
+        template<typename T>
+        IF_SHARED(T, bool) equal(const T& a, const T& b)
+        {
+            return a == b;
+        }
+        template<typename T>
+        IF_COLUMNS(T, bool) equal(const T& a, const T& b)
+        {
+            return serialization::detail::equal(static_cast<const typename T::Records&>(a), static_cast<const typename T::Records&>(b));
+        }
 
-            template<typename T>
-            IF_NOT_SERIALIZABLE(T, void) store(const char* name, const T& value);
+        /**
+         * The address of archive_tag<Archive> identifies Archive.
+         */
+        template<typename Archive>
+        inline constexpr char archive_tag = 0;
 
+        /**
+         * Used to check if a type provides everything serialize and deserialize need from an archive.
+         */
+        template<typename A, typename = void>
+        struct is_archive : std::false_type { };
+        template<typename A>
+        struct is_archive<A, std::void_t<
+            decltype(std::declval<A&>().template store<int>("", 0)),
+            decltype(std::declval<const A&>().template retrieve<int>("")),
+            decltype(bool(std::declval<A&>().saveToFile(std::string()))),
+            decltype(bool(std::declval<A&>().loadFromFile(std::string())))>> : std::true_type { };
 
-            // template<typename T>
-            // IS_STL_CONTAINER(T, T) retrieve(const char* name) const;
+        /**
+         * Lets archive read from its beginning again, if it supports that.
+         */
+        template<typename A>
+        auto rewind(const A& archive, int) -> decltype(archive.rewind(), void())
+        {
+            archive.rewind();
+        }
+        template<typename A>
+        void rewind(const A&, long)
+        {
+            // empty
+        }
 
-            template<typename T>
-            IF_SERIALIZABLE(T, T) retrieve(const char* name) const;
+        /**
+         * DELTA HELPER FUNCTIONS *
+         * A delta stores which properties changed as "$changed", followed by the changed properties. Changed
+         * nested objects are stored as deltas of their own. Which properties changed is decided by Changes.
+         */
+        template<typename T>
+        struct Comparison
+        {
+            using Type = T;
+            const T& current;
+            const T& baseline;
 
-            template<typename T>
-            IF_NOT_SERIALIZABLE(T, T) retrieve(const char* name) const;
+            template<std::size_t index>
+            bool changed() const
+            {
+                constexpr auto property = std::get<index>(T::PROPERTIES);
+                return !serialization::detail::equal(current.*(property.member), baseline.*(property.member));
+            }
+            template<std::size_t index>
+            auto nested() const
+            {
+                constexpr auto property = std::get<index>(T::PROPERTIES);
+                using Nested = typename decltype(property)::Type;
+                return Comparison<Nested> { current.*(property.member), baseline.*(property.member) };
+            }
         };
 
-        // template<typename T>
-        // IS_STL_CONTAINER(T, void) JsonArchive::store(const char* name, const T& value)
-        // {
-        //     JsonArchive archive;
-        //     int i = 0;
-        //     for(auto iterator = value.begin(); iterator != value.end(); iterator++)
-        //     {
-        //         archive.store(i++, *iterator);
-        //     }
-        //     storage[name] = archive;
-        // }
+        /**
+         * Returns true if object or any object nested in it has properties marked as dirty.
+         */
+        template<typename T>
+        bool isDirty(const T& object);
+
+        template<std::size_t index, typename T>
+        bool isDirtyProperty(const T& object)
+        {
+            constexpr auto property = std::get<index>(T::PROPERTIES);
+            if constexpr(has_properties<typename decltype(property)::Type>::value)
+            {
+                return serialization::detail::isDirty(object.*(property.member));
+            }
+            return false;
+        }
+
+        template<typename T, std::size_t... indices>
+        bool isDirty(const T& object, std::index_sequence<indices...>)
+        {
+            return (serialization::detail::isDirtyProperty<indices>(object) || ...);
+        }
+
+        template<typename T>
+        bool isDirty(const T& object)
+        {
+            if constexpr(std::is_base_of<Trackable, T>::value)
+            {
+                if(object.Trackable::isDirty())
+                {
+                    return true;
+                }
+            }
+            return serialization::detail::isDirty(object, std::make_index_sequence<std::tuple_size<decltype(T::PROPERTIES)>::value>());
+        }
+
+        /**
+         * Clears the dirty properties of object and of every object nested in it.
+         */
+        template<typename T>
+        void clearDirty(T& object);
+
+        template<std::size_t index, typename T>
+        void clearDirtyProperty(T& object)
+        {
+            constexpr auto property = std::get<index>(T::PROPERTIES);
+            if constexpr(has_properties<typename decltype(property)::Type>::value)
+            {
+                serialization::detail::clearDirty(object.*(property.member));
+            }
+        }
+
+        template<typename T, std::size_t... indices>
+        void clearDirty(T& object, std::index_sequence<indices...>)
+        {
+            (serialization::detail::clearDirtyProperty<indices>(object), ...);
+        }
 
         template<typename T>
-        IF_SERIALIZABLE(T, void) JsonArchive::store(const char* name, const T& value)
+        void clearDirty(T& object)
         {
-            storage[name] = serialize<JsonArchive>(value).getStorage();
+            if constexpr(std::is_base_of<Trackable, T>::value)
+            {
+                object.Trackable::clearDirty();
+            }
+            serialization::detail::clearDirty(object, std::make_index_sequence<std::tuple_size<decltype(T::PROPERTIES)>::value>());
         }
 
+        /**
+         * Changes that are the dirty properties of a Trackable. Objects that are not Trackable, or that were
+         * replaced as a whole, are stored with all their properties.
+         */
         template<typename T>
-        IF_NOT_SERIALIZABLE(T, void) JsonArchive::store(const char* name, const T& value)
+        struct DirtyFields
+        {
+            using Type = T;
+            const T& current;
+            bool all;
+
+            template<std::size_t index>
+            bool replaced() const
+            {
+                if constexpr(std::is_base_of<Trackable, T>::value)
+                {
+                    static_assert(std::tuple_size<decltype(T::PROPERTIES)>::value <= 64,
+                        "Trackable: only types with up to 64 properties can be tracked");
+                    return all || current.Trackable::isDirty(index);
+                }
+                return true;
+            }
+            template<std::size_t index>
+            bool changed() const
+            {
+                constexpr auto property = std::get<index>(T::PROPERTIES);
+                if(replaced<index>())
+                {
+                    return true;
+                }
+                if constexpr(has_properties<typename decltype(property)::Type>::value)
+                {
+                    return serialization::detail::isDirty(current.*(property.member));
+                }
+                return false;
+            }
+            template<std::size_t index>
+            auto nested() const
+            {
+                constexpr auto property = std::get<index>(T::PROPERTIES);
+                using Nested = typename decltype(property)::Type;
+                return DirtyFields<Nested> { current.*(property.member), replaced<index>() || !std::is_base_of<Trackable, Nested>::value };
+            }
+        };
+
+        template<typename IArchive, typename Changes>
+        void getDelta(const Changes& changes, IArchive& archive);
+
+        template<std::size_t index, typename IArchive, typename Changes>
+        void getDeltaProperty(const Changes& changes, IArchive& archive, bool changed)
+        {
+            constexpr auto property = std::get<index>(Changes::Type::PROPERTIES);
+            using Type = typename decltype(property)::Type;
+            if(!changed)
+            {
+                return;
+            }
+            if constexpr(has_properties<Type>::value)
+            {
+                IArchive nested;
+                serialization::detail::getDelta(changes.template nested<index>(), nested);
+                archive.storeArchive(property.name, nested);
+            }
+            else
+            {
+                serialization::detail::storeProperty(archive, property, changes.current.*(property.member));
+            }
+        }
+
+        template<typename IArchive, typename Changes, std::size_t... indices>
+        void getDelta(const Changes& changes, IArchive& archive, std::index_sequence<indices...>)
+        {
+            const std::vector<bool> changed { changes.template changed<indices>()... };
+            archive.store("$changed", changed);
+            (serialization::detail::getDeltaProperty<indices>(changes, archive, changed[indices]), ...);
+        }
+
+        template<typename IArchive, typename Changes>
+        void getDelta(const Changes& changes, IArchive& archive)
+        {
+            using T = typename Changes::Type;
+            serialization::detail::getDelta(changes, archive, std::make_index_sequence<std::tuple_size<decltype(T::PROPERTIES)>::value>());
+        }
+
+        template<typename IArchive, typename T>
+        void setDelta(T& object, const IArchive& archive);
+
+        template<std::size_t index, typename IArchive, typename T>
+        void setDeltaProperty(T& object, const IArchive& archive, bool changed)
+        {
+            constexpr auto property = std::get<index>(T::PROPERTIES);
+            using Type = typename decltype(property)::Type;
+            if(!changed)
+            {
+                return;
+            }
+            if constexpr(has_properties<Type>::value)
+            {
+                serialization::detail::setDelta(object.*(property.member), archive.retrieveArchive(property.name));
+            }
+            else
+            {
+                object.*(property.member) = serialization::detail::retrieveProperty(archive, property);
+            }
+        }
+
+        template<typename IArchive, typename T, std::size_t... indices>
+        void setDelta(T& object, const IArchive& archive, std::index_sequence<indices...>)
+        {
+            const std::vector<bool> changed = archive.template retrieve<std::vector<bool>>("$changed");
+            if(changed.size() != sizeof...(indices))
+            {
+                throw std::runtime_error("applyDelta: the delta was written for different PROPERTIES");
+            }
+            (serialization::detail::setDeltaProperty<indices>(object, archive, changed[indices]), ...);
+        }
+
+        template<typename IArchive, typename T>
+        void setDelta(T& object, const IArchive& archive)
+        {
+            serialization::detail::setDelta(object, archive, std::make_index_sequence<std::tuple_size<decltype(T::PROPERTIES)>::value>());
+        }
+
+        /**
+         * A tuple with an empty std::optional for the type of every property.
+         */
+        template<typename Properties>
+        struct property_cache;
+        template<typename... Properties>
+        struct property_cache<std::tuple<Properties...>>
+        {
+            using type = std::tuple<std::optional<typename Properties::Type>...>;
+        };
+
+        /**
+         * SERIALIZATION HELPER FUNCTIONS *
+         */
+        template<std::size_t iteration, typename T, typename IArchive>
+        void doGetData(T&& object, IArchive& archive)
         {
-            storage[name] = value;
+            constexpr auto property = std::get<iteration>(std::decay_t<T>::PROPERTIES);
+#if defined(SERIALIZATION_INSTRUMENTATION)
+            const instrumentation::Measurement measurement(archive.bytesWritten());
+#endif
+            serialization::detail::storeProperty(archive, property, object.*(property.member));
+#if defined(SERIALIZATION_INSTRUMENTATION)
+            measurement.report(instrumentation::Operation::Serialize, typeid(std::decay_t<T>).name(), property.name, archive.bytesWritten());
+#endif
+        }
+
+        /**
+         * If all properties have been visited, stop iterating.
+         */
+        template<std::size_t iteration, typename T, typename IArchive>
+        std::enable_if_t<(iteration >= std::tuple_size<decltype(std::decay_t<T>::PROPERTIES)>::value)>
+        getData(T&&, IArchive&)
+        {
+            // empty
+        }
+
+        /**
+         * Properties are visited in declaration order, so that sequential archives lay them out that way.
+         */
+        template<std::size_t iteration, typename T, typename IArchive>
+        std::enable_if_t<(iteration < std::tuple_size<decltype(std::decay_t<T>::PROPERTIES)>::value)>
+        getData(T&& object, IArchive& archive)
+        {
+            serialization::detail::doGetData<iteration, T, IArchive>(object, archive);
+            serialization::detail::getData<(iteration + 1), T, IArchive>(object, archive);
         }
 
+        /**
+         * POLYMORPHIC HELPER FUNCTIONS *
+         * Every type registered for Base has a small id, 0 stands for a null pointer. The ids index dense tables,
+         * so dispatching on the type of an object costs the same for any number of registered types.
+         */
+        template<typename Base>
+        struct PolymorphicTypes
+        {
+            std::unordered_map<std::type_index, std::uint32_t> ids;
+            std::vector<std::unique_ptr<Base> (*)()> factories;
+            std::vector<bool (*)(const Base&, const Base&)> comparators;
+
+            static PolymorphicTypes& get()
+            {
+                static PolymorphicTypes types;
+                return types;
+            }
+            std::uint32_t id(const Base& object) const
+            {
+                const auto found = ids.find(std::type_index(typeid(object)));
+                if(found == ids.end())
+                {
+                    throw std::runtime_error(std::string("serialization: type is not registered ") + typeid(object).name());
+                }
+                return found->second;
+            }
+            std::unique_ptr<Base> create(std::uint64_t id) const
+            {
+                if(id >= factories.size() || !factories[id])
+                {
+                    throw std::runtime_error("serialization: unknown type id " + std::to_string(id));
+                }
+                return factories[id]();
+            }
+            /**
+             * Objects of types that are not registered can't be compared, so they are never equal.
+             */
+            bool equal(const Base& a, const Base& b) const
+            {
+                if(typeid(a) != typeid(b))
+                {
+                    return false;
+                }
+                const auto found = ids.find(std::type_index(typeid(a)));
+                return found != ids.end() && found->second < comparators.size() && comparators[found->second]
+                    && comparators[found->second](a, b);
+            }
+        };
+
+        /**
+         * Stores and retrieves the properties of the registered types of Base, indexed by their id.
+         */
+        template<typename Base, typename Archive>
+        struct PolymorphicTable
+        {
+            struct Entry
+            {
+                void (*store)(const Base& object, Archive& archive);
+                void (*retrieve)(Base& object, const Archive& archive);
+            };
+
+            static std::vector<Entry>& entries()
+            {
+                static std::vector<Entry> table;
+                return table;
+            }
+            static const Entry& at(std::uint32_t id)
+            {
+                const std::vector<Entry>& table = entries();
+                if(id >= table.size() || !table[id].store)
+                {
+                    throw std::runtime_error("serialization: type id " + std::to_string(id) + " is not registered for this archive");
+                }
+                return table[id];
+            }
+
+            template<typename Derived>
+            static void add(std::uint32_t id)
+            {
+                std::vector<Entry>& table = entries();
+                table.resize(std::max<std::size_t>(table.size(), id + 1));
+                table[id] = Entry {
+                    [](const Base& object, Archive& archive)
+                    {
+                        serialization::detail::getData<0>(static_cast<const Derived&>(object), archive);
+                    },
+                    [](Base& object, const Archive& archive)
+                    {
+                        serialization::detail::setData<0>(static_cast<Derived&>(object), archive);
+                    }
+                };
+            }
+        };
+
+        /**
+         * OBJECT GRAPH HELPER FUNCTIONS *
+         * Maps the objects already written to their id. Open addressing with linear probing keeps the table in
+         * one array, which stays fast for millions of pointers.
+         */
+        class PointerTable
+        {
+        private:
+            struct Slot
+            {
+                const void* pointer;
+                std::uint64_t id;
+            };
+
+            std::vector<Slot> slots;
+            std::uint64_t count = 0;
+            unsigned shift = 64;
+
+            /**
+             * Fibonacci hashing, which spreads the aligned addresses over the whole table.
+             */
+            std::size_t index(const void* pointer) const
+            {
+                return static_cast<std::size_t>((static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(pointer)) * 0x9E3779B97F4A7C15ULL) >> shift);
+            }
+            void grow()
+            {
+                std::vector<Slot> old(slots.empty() ? 16 : slots.size() * 2, Slot { nullptr, 0 });
+                old.swap(slots);
+                shift = slots.size() == 16 ? 60 : shift - 1;
+                for(const Slot& slot : old)
+                {
+                    if(slot.pointer)
+                    {
+                        std::size_t i = index(slot.pointer);
+                        while(slots[i].pointer)
+                        {
+                            i = (i + 1) & (slots.size() - 1);
+                        }
+                        slots[i] = slot;
+                    }
+                }
+            }
+
+        public:
+            /**
+             * Returns the id of pointer and false, or gives it the next id and returns true.
+             */
+            std::pair<std::uint64_t, bool> insert(const void* pointer)
+            {
+                if((count + 1) * 2 > slots.size())
+                {
+                    grow();
+                }
+                for(std::size_t i = index(pointer);; i = (i + 1) & (slots.size() - 1))
+                {
+                    if(slots[i].pointer == pointer)
+                    {
+                        return { slots[i].id, false };
+                    }
+                    if(!slots[i].pointer)
+                    {
+                        slots[i] = Slot { pointer, ++count };
+                        return { count, true };
+                    }
+                }
+            }
+            void clear()
+            {
+                slots.clear();
+                count = 0;
+                shift = 64;
+            }
+        };
+
+        /**
+         * The shared objects of an archive. Objects are stored the first time they are reached and referred to
+         * by id afterwards. Read objects are registered before their properties are read, so cycles resolve.
+         */
+        struct ObjectGraph
+        {
+            PointerTable written;
+            std::vector<std::shared_ptr<void>> read;
+
+            /**
+             * Registers object as id, ids can not exceed limit, the size of the archive.
+             */
+            void add(std::uint64_t id, std::shared_ptr<void> object, std::size_t limit)
+            {
+                if(id == 0 || id > limit)
+                {
+                    throw std::runtime_error("serialization: invalid object id " + std::to_string(id));
+                }
+                if(id > read.size())
+                {
+                    read.resize(id);
+                }
+                if(read[id - 1])
+                {
+                    throw std::runtime_error("serialization: object " + std::to_string(id) + " is read twice");
+                }
+                read[id - 1] = std::move(object);
+            }
+            template<typename T>
+            std::shared_ptr<T> find(std::uint64_t id) const
+            {
+                if(id == 0 || id > read.size() || !read[id - 1])
+                {
+                    throw std::runtime_error("serialization: reference to object " + std::to_string(id) + ", which was not read");
+                }
+                return std::static_pointer_cast<T>(read[id - 1]);
+            }
+        };
+
+        /**
+         * The strings of a batch. A string is stored the first time it occurs and referred to by its index
+         * afterwards. Only strings of up to MAX_LENGTH bytes are kept, longer ones are rarely repeated. Kept
+         * strings point into the objects being written, or into the bytes being read.
+         */
+        struct StringTable
+        {
+            static constexpr std::size_t MAX_LENGTH = 64;
 
+            std::unordered_map<std::string_view, std::uint64_t> written;
+            std::vector<std::string_view> read;
 
-        // template<typename T>
-        // IS_STL_CONTAINER(T, T) retrieve(const char* name) const
-        // {
-        //     T result;
-        //     JsonArchive archive;
-        //     archive.setStorage(storage.at(name));
-        //     deserialize<JsonArchive>(archive, result);
-        //     return result;
-        // }
+            static bool keeps(std::size_t length)
+            {
+                return length != 0 && length <= MAX_LENGTH;
+            }
+            void clear()
+            {
+                written.clear();
+                read.clear();
+            }
+        };
 
-        template<>
-        IF_NOT_SERIALIZABLE(int, int) JsonArchive::retrieve<int>(const char* name) const
+        /**
+         * Creates the object a shared pointer to T is read into, using the registered type for polymorphic T.
+         */
+        template<typename T>
+        std::shared_ptr<T> createShared(std::uint32_t type)
         {
-            return storage.at(name).ToInt();
+            if constexpr(std::is_polymorphic<T>::value)
+            {
+                return std::shared_ptr<T>(serialization::detail::PolymorphicTypes<T>::get().create(type));
+            }
+            else
+            {
+                static_assert(has_properties<T>::value, "std::shared_ptr can only hold types with the SERIALIZE-macro or registered polymorphic types.");
+                return std::make_shared<T>();
+            }
         }
 
-        template<>
-        IF_NOT_SERIALIZABLE(std::string, std::string) JsonArchive::retrieve<std::string>(const char* name) const
+        /**
+         * BINARY ENCODING HELPER FUNCTIONS *
+         */
+        template<typename T>
+        void encodeLittleEndian(char* destination, T value)
         {
-            return storage.at(name).ToString();
+            std::memcpy(destination, &value, sizeof(T));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            std::reverse(destination, destination + sizeof(T));
+#endif
         }
 
-        // template<typename T>
-        // IF_IS_CONTAINER(T, T) JsonArchive::retrieve(const char* name) const
-        // {
-        //     std::vector<V> result;
-        //     auto jsonValue = storage.at(name);
-        //     for(int i=0; i<jsonValue.length(); i++)
-        //     {
-        //         JsonArchive archive;
-        //         archive.setStorage(jsonValue.at(i));
-        //         V value;
-        //         deserialize<JsonArchive>(archive, value);
-        //         result.push_back(value);
-        //     }
-        //     return result;
-        // }
+        template<typename T>
+        T decodeLittleEndian(const char* source)
+        {
+            char bytes[sizeof(T)];
+            std::memcpy(bytes, source, sizeof(T));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            std::reverse(bytes, bytes + sizeof(T));
+#endif
+            T value;
+            std::memcpy(&value, bytes, sizeof(T));
+            return value;
+        }
 
         template<typename T>
-        IF_SERIALIZABLE(T, T) JsonArchive::retrieve(const char* name) const
+        void writeLittleEndian(std::string& output, T value)
         {
-            T result;
-            JsonArchive archive;
-            archive.setStorage(storage.at(name));
-            deserialize<JsonArchive>(archive, result);
-            return result;
+            char bytes[sizeof(T)];
+            serialization::detail::encodeLittleEndian(bytes, value);
+            output.append(bytes, sizeof(T));
+        }
+
+        /**
+         * Whether numbers are held in memory the way they are stored, so they can be copied as they are.
+         */
+        inline constexpr bool nativeLittleEndian =
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            false;
+#else
+            true;
+#endif
+
+        /**
+         * Used to check if every property of a Type is a fixed-width number or an enum, so all its records are
+         * record_size bytes long.
+         */
+        template<typename T>
+        struct is_fixed_width : std::integral_constant<bool,
+            (std::is_arithmetic<T>::value && !std::is_same<T, bool>::value) || std::is_enum<T>::value> { };
+        template<typename Properties>
+        struct fixed_properties : std::false_type { };
+        template<typename... Properties>
+        struct fixed_properties<std::tuple<Properties...>> : std::integral_constant<bool, sizeof...(Properties) != 0 &&
+            (is_fixed_width<typename Properties::Type>::value && ...)> { };
+        template<typename T, typename = void>
+        struct is_fixed_record : std::false_type { };
+        template<typename T>
+        struct is_fixed_record<T, std::enable_if_t<has_properties<T>::value>> : fixed_properties<std::decay_t<decltype(T::PROPERTIES)>> { };
+
+        template<typename Properties>
+        struct properties_size;
+        template<typename... Properties>
+        struct properties_size<std::tuple<Properties...>> : std::integral_constant<std::size_t, (sizeof(typename Properties::Type) + ... + 0)> { };
+        template<typename T>
+        inline constexpr std::size_t record_size = properties_size<std::decay_t<decltype(T::PROPERTIES)>>::value;
+
+        /**
+         * Returns true if the memory of a T is exactly its stored record: trivially copyable, little-endian and
+         * without padding, with the members in the order of the properties. Everything but the order is checked
+         * at compile time, the member offsets once at runtime.
+         */
+        template<typename T>
+        bool isPackedRecord()
+        {
+            if constexpr(!is_fixed_record<T>::value || !std::is_trivially_copyable<T>::value || !std::is_default_constructible<T>::value ||
+                !nativeLittleEndian || record_size<T> != sizeof(T))
+            {
+                return false;
+            }
+            else
+            {
+                static const bool packed = []
+                {
+                    const T object {};
+                    const char* begin = reinterpret_cast<const char*>(&object);
+                    std::size_t offset = 0;
+                    bool result = true;
+                    std::apply([&](const auto&... property)
+                    {
+                        ((result = result && reinterpret_cast<const char*>(&(object.*property.member)) - begin == static_cast<std::ptrdiff_t>(offset),
+                            offset += sizeof(typename std::decay_t<decltype(property)>::Type)), ...);
+                    }, T::PROPERTIES);
+                    return result;
+                }();
+                return packed;
+            }
+        }
+
+        /**
+         * Writes an unsigned LEB128 varint, used for lengths and counts.
+         */
+        inline void writeVarint(std::string& output, std::uint64_t value)
+        {
+            while(value >= 0x80)
+            {
+                output.push_back(static_cast<char>(value | 0x80));
+                value >>= 7;
+            }
+            output.push_back(static_cast<char>(value));
+        }
+
+        /**
+         * DELTA CODING *
+         * Sequences stored with the Delta codec start with their first value. The differences between
+         * neighbours follow in blocks of DELTA_BLOCK, each holding its smallest difference, how many bits the
+         * others need above it, and those bits packed back to back. Values are taken modulo 2^64, so any integer
+         * sequence round-trips, and sorted ones pack into a few bits per value.
+         */
+        inline constexpr std::size_t DELTA_BLOCK = 128;
+
+        template<typename T, typename = void>
+        struct is_integer_sequence : std::false_type { };
+        template<typename T>
+        struct is_integer_sequence<T, std::enable_if_t<value_category<T>::value == Category::Container>> : std::integral_constant<bool,
+            std::is_integral<typename T::value_type>::value && !std::is_same<typename T::value_type, bool>::value> { };
+
+        inline std::uint64_t zigzag(std::uint64_t value)
+        {
+            return (value << 1) ^ (static_cast<std::uint64_t>(0) - (value >> 63));
+        }
+        inline std::uint64_t unzigzag(std::uint64_t value)
+        {
+            return (value >> 1) ^ (static_cast<std::uint64_t>(0) - (value & 1));
+        }
+
+        inline unsigned bitWidth(std::uint64_t value)
+        {
+#if defined(_MSC_VER)
+            unsigned long index;
+            return _BitScanReverse64(&index, value) ? static_cast<unsigned>(index) + 1 : 0;
+#else
+            return value ? 64 - static_cast<unsigned>(__builtin_clzll(value)) : 0;
+#endif
+        }
+
+        /**
+         * Appends the lowest width bits of every value, which takes (count * width + 7) / 8 bytes.
+         */
+        inline void packBits(std::string& output, const std::uint64_t* values, std::size_t count, unsigned width)
+        {
+            if(width == 0)
+            {
+                return;
+            }
+            std::uint64_t buffer = 0;
+            unsigned used = 0;
+            for(std::size_t i = 0; i < count; i++)
+            {
+                buffer |= values[i] << used;
+                if(used + width >= 64)
+                {
+                    serialization::detail::writeLittleEndian(output, buffer);
+                    buffer = used ? values[i] >> (64 - used) : 0;
+                    used = used + width - 64;
+                }
+                else
+                {
+                    used += width;
+                }
+            }
+            char bytes[sizeof(std::uint64_t)];
+            serialization::detail::encodeLittleEndian(bytes, buffer);
+            output.append(bytes, (used + 7) / 8);
+        }
+
+        /**
+         * Reads count values packed by packBits. Every value is one unaligned 64-bit load, so width has to be at
+         * most 57 bits, or exactly 64.
+         */
+        inline void unpackBits(const char* data, std::size_t count, unsigned width, std::uint64_t* values)
+        {
+            char padded[DELTA_BLOCK * sizeof(std::uint64_t) + sizeof(std::uint64_t)] = {};
+            std::memcpy(padded, data, (count * width + 7) / 8);
+            const std::uint64_t mask = width == 64 ? ~static_cast<std::uint64_t>(0) : (static_cast<std::uint64_t>(1) << width) - 1;
+            for(std::size_t i = 0; i < count; i++)
+            {
+                const std::size_t bit = i * width;
+                values[i] = (serialization::detail::decodeLittleEndian<std::uint64_t>(padded + bit / 8) >> (bit % 8)) & mask;
+            }
+        }
+
+        inline void addToAll(std::uint64_t* values, std::size_t count, std::uint64_t offset)
+        {
+            std::size_t i = 0;
+#if defined(SERIALIZATION_SSE2)
+            const __m128i add = _mm_set1_epi64x(static_cast<long long>(offset));
+            for(; i + 2 <= count; i += 2)
+            {
+                __m128i* pair = reinterpret_cast<__m128i*>(values + i);
+                _mm_storeu_si128(pair, _mm_add_epi64(_mm_loadu_si128(pair), add));
+            }
+#endif
+            for(; i < count; i++)
+            {
+                values[i] += offset;
+            }
+        }
+
+        /**
+         * Turns the differences in values, each base less than the actual difference, into the values following
+         * previous, and returns the last one. A running sum has to wait for every addition before it, so the
+         * block is summed as four quarters at once, and the quarters are then offset by the sums in front of them.
+         */
+        inline std::uint64_t prefixSum(std::uint64_t* values, std::size_t count, std::uint64_t base, std::uint64_t previous)
+        {
+            const std::size_t quarter = count / 4;
+            std::uint64_t sums[4] = { previous, 0, 0, 0 };
+            for(std::size_t i = 0; i < quarter; i++)
+            {
+                for(std::size_t lane = 0; lane < 4; lane++)
+                {
+                    std::uint64_t& value = values[lane * quarter + i];
+                    sums[lane] += value + base;
+                    value = sums[lane];
+                }
+            }
+            for(std::size_t lane = 1; lane < 4; lane++)
+            {
+                serialization::detail::addToAll(values + lane * quarter, quarter, sums[lane - 1]);
+                sums[lane] += sums[lane - 1];
+            }
+            previous = sums[3];
+            for(std::size_t i = quarter * 4; i < count; i++)
+            {
+                previous += values[i] + base;
+                values[i] = previous;
+            }
+            return previous;
+        }
+
+        /**
+         * Appends one block of differences: the smallest as zigzag varint, the bit width, then the packed rest.
+         * Widths between 58 and 63 bits are stored as 64, so unpackBits can read every value with one load.
+         */
+        inline void packDeltas(std::string& output, std::uint64_t* deltas, std::size_t count)
+        {
+            std::int64_t smallest = std::numeric_limits<std::int64_t>::max();
+            for(std::size_t i = 0; i < count; i++)
+            {
+                smallest = std::min(smallest, static_cast<std::int64_t>(deltas[i]));
+            }
+            std::uint64_t largest = 0;
+            for(std::size_t i = 0; i < count; i++)
+            {
+                deltas[i] -= static_cast<std::uint64_t>(smallest);
+                largest = std::max(largest, deltas[i]);
+            }
+            unsigned width = serialization::detail::bitWidth(largest);
+            if(width > 57)
+            {
+                width = 64;
+            }
+            serialization::detail::writeVarint(output, serialization::detail::zigzag(static_cast<std::uint64_t>(smallest)));
+            output.push_back(static_cast<char>(width));
+            serialization::detail::packBits(output, deltas, count, width);
+        }
+
+        /**
+         * JSON STRUCTURAL INDEX *
+         * The JSON reader works in two stages, like simdjson: the first stage classifies the text in blocks of
+         * 64 bytes and records the position of every structural character ({}[]:,) and of both quotes of every
+         * string. The second stage walks that index to find the properties that are actually retrieved.
+         */
+        inline int countTrailingZeros(std::uint64_t bits)
+        {
+#if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward64(&index, bits);
+            return static_cast<int>(index);
+#else
+            return __builtin_ctzll(bits);
+#endif
+        }
+
+        /**
+         * Bitmasks of one 64 byte block, bit i belongs to the i-th byte.
+         */
+        struct JsonBlock
+        {
+            std::uint64_t quotes;
+            std::uint64_t backslashes;
+            std::uint64_t operators;
+            std::uint64_t nonAscii;
+        };
+
+        inline JsonBlock classifyJsonScalar(const char* block)
+        {
+            JsonBlock result { 0, 0, 0, 0 };
+            for(int i = 0; i < 64; i++)
+            {
+                const std::uint64_t bit = std::uint64_t(1) << i;
+                switch(block[i])
+                {
+                    case '"': result.quotes |= bit; break;
+                    case '\\': result.backslashes |= bit; break;
+                    case '{': case '}': case '[': case ']': case ':': case ',': result.operators |= bit; break;
+                    default:
+                        if(static_cast<unsigned char>(block[i]) >= 0x80)
+                        {
+                            result.nonAscii |= bit;
+                        }
+                        break;
+                }
+            }
+            return result;
+        }
+
+#if defined(SERIALIZATION_SSE2)
+        inline JsonBlock classifyJsonSse2(const char* block)
+        {
+            JsonBlock result { 0, 0, 0, 0 };
+            for(int i = 0; i < 4; i++)
+            {
+                const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+                // '[' and ']' only differ from '{' and '}' in bit 5
+                const __m128i folded = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+                const __m128i operators = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')), _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+                    _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(':')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8(','))));
+                const int shift = 16 * i;
+                result.quotes |= std::uint64_t(static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('"'))))) << shift;
+                result.backslashes |= std::uint64_t(static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\'))))) << shift;
+                result.operators |= std::uint64_t(static_cast<std::uint16_t>(_mm_movemask_epi8(operators))) << shift;
+                result.nonAscii |= std::uint64_t(static_cast<std::uint16_t>(_mm_movemask_epi8(chunk))) << shift;
+            }
+            return result;
+        }
+#endif
+
+#if defined(SERIALIZATION_AVX2)
+        SERIALIZATION_AVX2 inline JsonBlock classifyJsonAvx2(const char* block)
+        {
+            JsonBlock result { 0, 0, 0, 0 };
+            for(int i = 0; i < 2; i++)
+            {
+                const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32 * i));
+                const __m256i folded = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+                const __m256i operators = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}'))),
+                    _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(','))));
+                const int shift = 32 * i;
+                result.quotes |= std::uint64_t(static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"'))))) << shift;
+                result.backslashes |= std::uint64_t(static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\\'))))) << shift;
+                result.operators |= std::uint64_t(static_cast<std::uint32_t>(_mm256_movemask_epi8(operators))) << shift;
+                result.nonAscii |= std::uint64_t(static_cast<std::uint32_t>(_mm256_movemask_epi8(chunk))) << shift;
+            }
+            return result;
+        }
+#endif
+
+        using JsonClassifier = JsonBlock (*)(const char*);
+
+        /**
+         * Picks the widest block classifier the running CPU supports.
+         */
+        inline JsonClassifier selectJsonClassifier()
+        {
+#if defined(SERIALIZATION_AVX2)
+            __builtin_cpu_init();
+            if(__builtin_cpu_supports("avx2"))
+            {
+                return classifyJsonAvx2;
+            }
+#endif
+#if defined(SERIALIZATION_SSE2)
+            return classifyJsonSse2;
+#else
+            return classifyJsonScalar;
+#endif
+        }
+
+        /**
+         * Sets every bit that is preceded by an odd number of set bits (including itself).
+         */
+        inline std::uint64_t prefixXor(std::uint64_t bits)
+        {
+            bits ^= bits << 1;
+            bits ^= bits << 2;
+            bits ^= bits << 4;
+            bits ^= bits << 8;
+            bits ^= bits << 16;
+            bits ^= bits << 32;
+            return bits;
+        }
+
+        /**
+         * Validates the run of multi-byte UTF-8 sequences starting at offset and returns the offset of the next
+         * ASCII character.
+         */
+        inline std::size_t validateUtf8(std::string_view text, std::size_t offset)
+        {
+            while(offset < text.size())
+            {
+                const auto lead = static_cast<unsigned char>(text[offset]);
+                std::size_t length;
+                std::uint32_t codepoint;
+                std::uint32_t minimum;
+                if(lead < 0x80)
+                {
+                    return offset;
+                }
+                else if((lead & 0xe0) == 0xc0)
+                {
+                    length = 2;
+                    codepoint = lead & 0x1f;
+                    minimum = 0x80;
+                }
+                else if((lead & 0xf0) == 0xe0)
+                {
+                    length = 3;
+                    codepoint = lead & 0x0f;
+                    minimum = 0x800;
+                }
+                else if((lead & 0xf8) == 0xf0)
+                {
+                    length = 4;
+                    codepoint = lead & 0x07;
+                    minimum = 0x10000;
+                }
+                else
+                {
+                    throw std::runtime_error("JsonArchive: invalid UTF-8");
+                }
+                if(length > text.size() - offset)
+                {
+                    throw std::runtime_error("JsonArchive: invalid UTF-8");
+                }
+                for(std::size_t i = 1; i < length; i++)
+                {
+                    const auto continuation = static_cast<unsigned char>(text[offset + i]);
+                    if((continuation & 0xc0) != 0x80)
+                    {
+                        throw std::runtime_error("JsonArchive: invalid UTF-8");
+                    }
+                    codepoint = (codepoint << 6) | (continuation & 0x3f);
+                }
+                if(codepoint < minimum || codepoint > 0x10ffff || (codepoint >= 0xd800 && codepoint < 0xe000))
+                {
+                    throw std::runtime_error("JsonArchive: invalid UTF-8");
+                }
+                offset += length;
+            }
+            return offset;
+        }
+
+        /**
+         * First stage: writes the offsets of all structural characters outside of strings, and of all unescaped
+         * quotes, to structurals. Validates the text as UTF-8 on the way, blocks without any byte >= 0x80 are
+         * accepted without looking at them again.
+         */
+        inline void indexJson(std::string_view text, std::vector<std::uint32_t>& structurals)
+        {
+            static const JsonClassifier classify = selectJsonClassifier();
+            if(text.size() > UINT32_MAX)
+            {
+                throw std::length_error("JsonArchive: documents are limited to 4 GiB");
+            }
+            structurals.clear();
+            structurals.reserve(text.size() / 4);
+
+            std::uint64_t escapeCarry = 0;
+            std::uint64_t inString = 0;
+            std::size_t validated = 0;
+            char padded[64];
+            for(std::size_t offset = 0; offset < text.size(); offset += 64)
+            {
+                const char* block = text.data() + offset;
+                if(text.size() - offset < 64)
+                {
+                    std::memset(padded, ' ', sizeof(padded));
+                    std::memcpy(padded, block, text.size() - offset);
+                    block = padded;
+                }
+                const JsonBlock masks = classify(block);
+
+                for(std::uint64_t nonAscii = masks.nonAscii; nonAscii; nonAscii &= nonAscii - 1)
+                {
+                    const std::size_t sequence = offset + countTrailingZeros(nonAscii);
+                    if(sequence >= validated)
+                    {
+                        validated = serialization::detail::validateUtf8(text, sequence);
+                    }
+                }
+
+                // backslashes are rare, so the escaped characters are resolved one backslash at a time
+                std::uint64_t escaped = escapeCarry;
+                std::uint64_t backslashes = masks.backslashes & ~escapeCarry;
+                escapeCarry = 0;
+                while(backslashes)
+                {
+                    const std::uint64_t backslash = backslashes & (~backslashes + 1);
+                    const std::uint64_t next = backslash << 1;
+                    escapeCarry = next ? 0 : 1;
+                    escaped |= next;
+                    backslashes &= ~(backslash | next);
+                }
+
+                const std::uint64_t quotes = masks.quotes & ~escaped;
+                const std::uint64_t strings = prefixXor(quotes) ^ inString;
+                inString = static_cast<std::uint64_t>(static_cast<std::int64_t>(strings) >> 63);
+
+                std::uint64_t found = (masks.operators & ~strings) | quotes;
+                while(found)
+                {
+                    structurals.push_back(static_cast<std::uint32_t>(offset + countTrailingZeros(found)));
+                    found &= found - 1;
+                }
+            }
+            if(inString)
+            {
+                throw std::runtime_error("JsonArchive: unterminated string");
+            }
+        }
+
+        inline void appendUtf8(std::string& output, std::uint32_t codepoint)
+        {
+            if(codepoint < 0x80)
+            {
+                output.push_back(static_cast<char>(codepoint));
+            }
+            else if(codepoint < 0x800)
+            {
+                output.push_back(static_cast<char>(0xc0 | (codepoint >> 6)));
+                output.push_back(static_cast<char>(0x80 | (codepoint & 0x3f)));
+            }
+            else if(codepoint < 0x10000)
+            {
+                output.push_back(static_cast<char>(0xe0 | (codepoint >> 12)));
+                output.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f)));
+                output.push_back(static_cast<char>(0x80 | (codepoint & 0x3f)));
+            }
+            else
+            {
+                output.push_back(static_cast<char>(0xf0 | (codepoint >> 18)));
+                output.push_back(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3f)));
+                output.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f)));
+                output.push_back(static_cast<char>(0x80 | (codepoint & 0x3f)));
+            }
+        }
+
+        inline std::uint32_t parseHex4(std::string_view raw, std::size_t offset)
+        {
+            std::uint32_t value = 0;
+            if(raw.size() < offset + 4 || std::from_chars(raw.data() + offset, raw.data() + offset + 4, value, 16).ptr != raw.data() + offset + 4)
+            {
+                throw std::runtime_error("JsonArchive: invalid \\u escape");
+            }
+            return value;
+        }
+
+        /**
+         * Decodes the contents of a JSON string (without the quotes).
+         */
+        inline std::string unescapeJson(std::string_view raw)
+        {
+            std::string result;
+            result.reserve(raw.size());
+            std::size_t i = 0;
+            while(true)
+            {
+                // find is a memchr, so the runs between escapes are located and copied in blocks
+                const std::size_t backslash = raw.find('\\', i);
+                result.append(raw.data() + i, std::min(backslash, raw.size()) - i);
+                if(backslash == std::string_view::npos)
+                {
+                    return result;
+                }
+                if(backslash + 1 >= raw.size())
+                {
+                    throw std::runtime_error("JsonArchive: invalid escape sequence");
+                }
+                i = backslash + 2;
+                switch(raw[backslash + 1])
+                {
+                    case '"': result.push_back('"'); break;
+                    case '\\': result.push_back('\\'); break;
+                    case '/': result.push_back('/'); break;
+                    case 'b': result.push_back('\b'); break;
+                    case 'f': result.push_back('\f'); break;
+                    case 'n': result.push_back('\n'); break;
+                    case 'r': result.push_back('\r'); break;
+                    case 't': result.push_back('\t'); break;
+                    case 'u':
+                    {
+                        std::uint32_t codepoint = parseHex4(raw, i);
+                        i += 4;
+                        if(codepoint >= 0xd800 && codepoint < 0xdc00 && raw.substr(i, 2) == "\\u")
+                        {
+                            const std::uint32_t low = parseHex4(raw, i + 2);
+                            if(low >= 0xdc00 && low < 0xe000)
+                            {
+                                codepoint = 0x10000 + ((codepoint - 0xd800) << 10) + (low - 0xdc00);
+                                i += 6;
+                            }
+                        }
+                        serialization::detail::appendUtf8(result, codepoint);
+                        break;
+                    }
+                    default: throw std::runtime_error("JsonArchive: invalid escape sequence");
+                }
+            }
+        }
+
+        /**
+         * Parses a JSON number into T, failing on anything that does not fit.
+         */
+        template<typename T, bool = std::is_integral<T>::value>
+        struct parsed_type
+        {
+            using type = T;
+        };
+        /**
+         * Character types like char16_t are parsed as the integer type of the same size.
+         */
+        template<typename T>
+        struct parsed_type<T, true>
+        {
+            using type = std::conditional_t<std::is_signed<T>::value, std::make_signed_t<T>, std::make_unsigned_t<T>>;
+        };
+
+        template<typename T>
+        T parseJsonNumber(std::string_view text)
+        {
+            // non-finite numbers are written as null
+            if constexpr(std::is_floating_point<T>::value)
+            {
+                if(text == "null")
+                {
+                    return std::numeric_limits<T>::quiet_NaN();
+                }
+            }
+            typename parsed_type<T>::type result;
+            const auto parsed = std::from_chars(text.data(), text.data() + text.size(), result);
+            if(parsed.ec != std::errc() || parsed.ptr != text.data() + text.size())
+            {
+                throw std::runtime_error("JsonArchive: invalid number " + std::string(text));
+            }
+            return static_cast<T>(result);
+        }
+
+        /**
+         * JSON OUTPUT *
+         */
+        inline constexpr char digitPairs[] =
+            "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+            "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+            "8081828384858687888990919293949596979899";
+
+        /**
+         * Writes an integer two digits at a time from a lookup table.
+         */
+        template<typename T>
+        std::enable_if_t<std::is_integral<T>::value && !std::is_same<T, bool>::value> writeJson(std::string& output, T value)
+        {
+            using Unsigned = std::make_unsigned_t<T>;
+            Unsigned magnitude = static_cast<Unsigned>(value);
+            if constexpr(std::is_signed<T>::value)
+            {
+                if(value < 0)
+                {
+                    output.push_back('-');
+                    magnitude = static_cast<Unsigned>(Unsigned(0) - magnitude);
+                }
+            }
+            char buffer[20];
+            char* begin = buffer + sizeof(buffer);
+            while(magnitude >= 100)
+            {
+                const std::size_t pair = static_cast<std::size_t>(magnitude % 100) * 2;
+                magnitude = static_cast<Unsigned>(magnitude / 100);
+                *--begin = digitPairs[pair + 1];
+                *--begin = digitPairs[pair];
+            }
+            if(magnitude >= 10)
+            {
+                const std::size_t pair = static_cast<std::size_t>(magnitude) * 2;
+                *--begin = digitPairs[pair + 1];
+                *--begin = digitPairs[pair];
+            }
+            else
+            {
+                *--begin = static_cast<char>('0' + magnitude);
+            }
+            output.append(begin, buffer + sizeof(buffer));
+        }
+
+        /**
+         * Writes the shortest representation that parses back to the same value.
+         */
+        template<typename T>
+        std::enable_if_t<std::is_floating_point<T>::value> writeJson(std::string& output, T value)
+        {
+            if(!std::isfinite(value))
+            {
+                output += "null";
+                return;
+            }
+            char buffer[64];
+            const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+            output.append(buffer, result.ptr);
+        }
+
+        inline void writeJson(std::string& output, bool value)
+        {
+            output += value ? "true" : "false";
+        }
+
+        /**
+         * Returns the offset of the first character at or after offset that has to be escaped, or value.size().
+         */
+        inline std::size_t findJsonEscape(std::string_view value, std::size_t offset)
+        {
+#if defined(SERIALIZATION_SSE2)
+            const __m128i quote = _mm_set1_epi8('"');
+            const __m128i backslash = _mm_set1_epi8('\\');
+            const __m128i control = _mm_set1_epi8(0x1f);
+            for(; value.size() - offset >= 16; offset += 16)
+            {
+                const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(value.data() + offset));
+                // chunk <= 0x1f, unsigned
+                const __m128i controls = _mm_cmpeq_epi8(_mm_min_epu8(chunk, control), chunk);
+                const __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)), controls);
+                const auto mask = static_cast<std::uint64_t>(_mm_movemask_epi8(special));
+                if(mask)
+                {
+                    return offset + countTrailingZeros(mask);
+                }
+            }
+#endif
+            for(; offset < value.size(); offset++)
+            {
+                const auto c = static_cast<unsigned char>(value[offset]);
+                if(c < 0x20 || c == '"' || c == '\\')
+                {
+                    return offset;
+                }
+            }
+            return value.size();
+        }
+
+        /**
+         * Writes a JSON string, copying everything between characters that have to be escaped in one go.
+         */
+        inline void writeJson(std::string& output, std::string_view value)
+        {
+            output.push_back('"');
+            std::size_t clean = 0;
+            for(std::size_t i = findJsonEscape(value, 0); i < value.size(); i = findJsonEscape(value, clean))
+            {
+                const auto c = static_cast<unsigned char>(value[i]);
+                output.append(value.data() + clean, i - clean);
+                clean = i + 1;
+                switch(c)
+                {
+                    case '"': output += "\\\""; break;
+                    case '\\': output += "\\\\"; break;
+                    case '\b': output += "\\b"; break;
+                    case '\f': output += "\\f"; break;
+                    case '\n': output += "\\n"; break;
+                    case '\r': output += "\\r"; break;
+                    case '\t': output += "\\t"; break;
+                    default:
+                        output += "\\u00";
+                        output.push_back("0123456789abcdef"[c >> 4]);
+                        output.push_back("0123456789abcdef"[c & 0xf]);
+                        break;
+                }
+            }
+            output.append(value.data() + clean, value.size() - clean);
+            output.push_back('"');
+        }
+
+        /**
+         * Writes an enum by name if it has enum_names and the value is in range, and as its value otherwise.
+         */
+        template<typename T>
+        std::enable_if_t<std::is_enum<T>::value> writeJson(std::string& output, T value)
+        {
+            using Underlying = std::underlying_type_t<T>;
+            if constexpr(has_enum_names<T>::value)
+            {
+                const auto index = static_cast<std::make_unsigned_t<Underlying>>(value);
+                if(index < std::size(serialization::enum_names<T>::names))
+                {
+                    serialization::detail::writeJson(output, std::string_view(serialization::enum_names<T>::names[index]));
+                    return;
+                }
+            }
+            serialization::detail::writeJson(output, static_cast<Underlying>(value));
+        }
+
+        inline void writeJsonTree(std::string& output, const json::JSON& value)
+        {
+            switch(value.JSONType())
+            {
+                case json::JSON::Class::Object:
+                {
+                    output.push_back('{');
+                    bool first = true;
+                    for(const auto& member : value.ObjectRange())
+                    {
+                        if(!first)
+                        {
+                            output.push_back(',');
+                        }
+                        first = false;
+                        serialization::detail::writeJson(output, std::string_view(member.first));
+                        output.push_back(':');
+                        serialization::detail::writeJsonTree(output, member.second);
+                    }
+                    output.push_back('}');
+                    break;
+                }
+                case json::JSON::Class::Array:
+                {
+                    output.push_back('[');
+                    bool first = true;
+                    for(const auto& element : value.ArrayRange())
+                    {
+                        if(!first)
+                        {
+                            output.push_back(',');
+                        }
+                        first = false;
+                        serialization::detail::writeJsonTree(output, element);
+                    }
+                    output.push_back(']');
+                    break;
+                }
+                case json::JSON::Class::String:
+                    // SimpleJSON hands out strings escaped
+                    serialization::detail::writeJson(output, std::string_view(serialization::detail::unescapeJson(value.ToString())));
+                    break;
+                case json::JSON::Class::Floating:
+                    serialization::detail::writeJson(output, value.ToFloat());
+                    break;
+                case json::JSON::Class::Integral:
+                    serialization::detail::writeJson(output, value.ToInt());
+                    break;
+                case json::JSON::Class::Boolean:
+                    serialization::detail::writeJson(output, value.ToBool());
+                    break;
+                default:
+                    output += "null";
+                    break;
+            }
+        }
+
+        /**
+         * A value inside a JsonDocument.
+         */
+        struct JsonValue
+        {
+            /** The first structural at or after the value, for scalars this is the one terminating them. */
+            std::uint32_t token;
+            /** The offset of the first character of the value. */
+            std::uint32_t begin;
+        };
+
+        /**
+         * Second stage: a parsed JSON text together with its structural index.
+         */
+        class JsonDocument
+        {
+        public:
+            std::string text;
+            std::vector<std::uint32_t> structurals;
+            /** For every opening bracket, the structural of the matching closing one. */
+            std::vector<std::uint32_t> matches;
+
+            explicit JsonDocument(std::string aText)
+            : text(std::move(aText))
+            {
+                serialization::detail::indexJson(text, structurals);
+                matchBrackets();
+            }
+
+            char tokenAt(std::uint32_t token) const
+            {
+                return token < structurals.size() ? text[structurals[token]] : '\0';
+            }
+            char kind(JsonValue value) const
+            {
+                return value.begin < text.size() ? text[value.begin] : '\0';
+            }
+            JsonValue root() const
+            {
+                return JsonValue { 0, skipWhitespace(0) };
+            }
+            /**
+             * Returns the value following the structural at token, eg. after a ':', ',' or '['.
+             */
+            JsonValue valueAfter(std::uint32_t token) const
+            {
+                return JsonValue { token + 1, skipWhitespace(structurals[token] + 1) };
+            }
+            /**
+             * Returns the first structural after value.
+             */
+            std::uint32_t end(JsonValue value) const
+            {
+                switch(kind(value))
+                {
+                    case '"':
+                        return value.token + 2;
+                    case '{':
+                    case '[':
+                        return matches[value.token] + 1;
+                    default:
+                        return value.token;
+                }
+            }
+            /**
+             * Returns the text of a number or literal.
+             */
+            std::string_view scalar(JsonValue value) const
+            {
+                std::size_t end = value.token < structurals.size() ? structurals[value.token] : text.size();
+                while(end > value.begin && isWhitespace(text[end - 1]))
+                {
+                    end--;
+                }
+                return std::string_view(text).substr(value.begin, end - value.begin);
+            }
+            /**
+             * Returns the raw contents of a string, without quotes and escapes still in place.
+             */
+            std::string_view rawString(JsonValue value) const
+            {
+                expect(value, '"');
+                const std::uint32_t begin = structurals[value.token] + 1;
+                return std::string_view(text).substr(begin, structurals[value.token + 1] - begin);
+            }
+            std::string string(JsonValue value) const
+            {
+                return serialization::detail::unescapeJson(rawString(value));
+            }
+            /**
+             * Returns the span of text covered by value.
+             */
+            std::string_view span(JsonValue value) const
+            {
+                const std::uint32_t next = end(value);
+                switch(kind(value))
+                {
+                    case '"':
+                    case '{':
+                    case '[':
+                        return std::string_view(text).substr(value.begin, structurals[next - 1] + 1 - value.begin);
+                    default:
+                        return scalar(value);
+                }
+            }
+            /**
+             * Returns the raw name of the first member of object, or nothing if it is empty.
+             */
+            std::string_view firstKey(JsonValue object) const
+            {
+                expect(object, '{');
+                if(tokenAt(object.token + 1) != '"')
+                {
+                    return std::string_view();
+                }
+                return rawString(JsonValue { object.token + 1, structurals[object.token + 1] });
+            }
+            /**
+             * Calls visit with every element of array.
+             */
+            template<typename Visitor>
+            void forEachElement(JsonValue array, Visitor&& visit) const
+            {
+                expect(array, '[');
+                JsonValue element = valueAfter(array.token);
+                if(kind(element) == ']')
+                {
+                    return;
+                }
+                while(true)
+                {
+                    visit(element);
+                    const std::uint32_t next = end(element);
+                    const char separator = tokenAt(next);
+                    if(separator == ']')
+                    {
+                        return;
+                    }
+                    if(separator != ',')
+                    {
+                        throw std::runtime_error("JsonArchive: malformed array");
+                    }
+                    element = valueAfter(next);
+                }
+            }
+            /**
+             * Finds the member called name of object. The search starts at hint, which is then set to the member
+             * following the result, so properties that are retrieved in document order are found immediately.
+             */
+            JsonValue member(JsonValue object, std::string_view name, std::uint32_t& hint) const
+            {
+                expect(object, '{');
+                const std::uint32_t first = object.token + 1;
+                const std::uint32_t start = hint > object.token ? hint : first;
+                std::uint32_t key = start;
+                do
+                {
+                    if(tokenAt(key) == '}')
+                    {
+                        key = first;
+                        if(tokenAt(key) == '}')
+                        {
+                            break;
+                        }
+                        continue;
+                    }
+                    if(tokenAt(key) != '"' || tokenAt(key + 2) != ':')
+                    {
+                        throw std::runtime_error("JsonArchive: malformed object");
+                    }
+                    const JsonValue value = valueAfter(key + 2);
+                    const std::uint32_t next = end(value);
+                    const char separator = tokenAt(next);
+                    if(separator != ',' && separator != '}')
+                    {
+                        throw std::runtime_error("JsonArchive: malformed object");
+                    }
+                    const std::string_view rawKey = rawString(JsonValue { key, structurals[key] });
+                    if(rawKey == name || (rawKey.find('\\') != std::string_view::npos && unescapeJson(rawKey) == name))
+                    {
+                        hint = separator == ',' ? next + 1 : next;
+                        return value;
+                    }
+                    key = separator == ',' ? next + 1 : next;
+                }
+                while(key != start);
+                throw std::out_of_range("JsonArchive: no member called " + std::string(name));
+            }
+
+        private:
+            /**
+             * Pairs up the brackets once, so skipping an object or array never has to look inside it.
+             */
+            void matchBrackets()
+            {
+                matches.resize(structurals.size());
+                std::vector<std::uint32_t> open;
+                for(std::uint32_t token = 0; token < structurals.size(); token++)
+                {
+                    const char c = tokenAt(token);
+                    if(c == '{' || c == '[')
+                    {
+                        open.push_back(token);
+                    }
+                    else if(c == '}' || c == ']')
+                    {
+                        if(open.empty() || tokenAt(open.back()) != (c == '}' ? '{' : '['))
+                        {
+                            throw std::runtime_error("JsonArchive: unbalanced brackets");
+                        }
+                        matches[open.back()] = token;
+                        open.pop_back();
+                    }
+                }
+                if(!open.empty())
+                {
+                    throw std::runtime_error("JsonArchive: unbalanced brackets");
+                }
+            }
+            static bool isWhitespace(char c)
+            {
+                return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+            }
+            std::uint32_t skipWhitespace(std::size_t offset) const
+            {
+                while(offset < text.size() && isWhitespace(text[offset]))
+                {
+                    offset++;
+                }
+                return static_cast<std::uint32_t>(offset);
+            }
+            void expect(JsonValue value, char c) const
+            {
+                if(kind(value) != c || tokenAt(value.token) != c || structurals[value.token] != value.begin)
+                {
+                    throw std::runtime_error(std::string("JsonArchive: expected '") + c + "'");
+                }
+            }
+        };
+
+        /**
+         * JSON INPUT *
+         */
+        template<typename T>
+        std::enable_if_t<std::is_arithmetic<T>::value && !std::is_same<T, bool>::value, T> readJson(const JsonDocument& document, JsonValue value)
+        {
+            return serialization::detail::parseJsonNumber<T>(document.scalar(value));
+        }
+
+        template<typename T>
+        std::enable_if_t<std::is_same<T, bool>::value, T> readJson(const JsonDocument& document, JsonValue value)
+        {
+            const std::string_view literal = document.scalar(value);
+            if(literal != "true" && literal != "false")
+            {
+                throw std::runtime_error("JsonArchive: expected a bool, got " + std::string(literal));
+            }
+            return literal == "true";
+        }
+
+        template<typename T>
+        std::enable_if_t<std::is_same<T, std::string>::value, T> readJson(const JsonDocument& document, JsonValue value)
+        {
+            return document.string(value);
+        }
+
+        template<typename T>
+        std::enable_if_t<std::is_enum<T>::value, T> readJson(const JsonDocument& document, JsonValue value)
+        {
+            using Underlying = std::underlying_type_t<T>;
+            if(document.kind(value) != '"')
+            {
+                return static_cast<T>(serialization::detail::parseJsonNumber<Underlying>(document.scalar(value)));
+            }
+            if constexpr(has_enum_names<T>::value)
+            {
+                const std::string name = document.string(value);
+                const auto& names = serialization::enum_names<T>::names;
+                for(std::size_t index = 0; index < std::size(names); index++)
+                {
+                    if(name == names[index])
+                    {
+                        return static_cast<T>(index);
+                    }
+                }
+                throw std::runtime_error("JsonArchive: unknown enum name " + name);
+            }
+            throw std::runtime_error("JsonArchive: enum has no enum_names to read a name with");
+        }
+
+        /**
+         * CHECKSUMS *
+         * CRC32C (Castagnoli), the checksum the SSE4.2 crc32 instruction computes. Without it, a table
+         * handles 8 bytes per step.
+         */
+        inline const std::array<std::array<std::uint32_t, 256>, 8>& crc32cTable()
+        {
+            static const auto table = []()
+            {
+                std::array<std::array<std::uint32_t, 256>, 8> result{};
+                for(std::uint32_t i = 0; i < 256; ++i)
+                {
+                    std::uint32_t crc = i;
+                    for(int bit = 0; bit < 8; ++bit)
+                    {
+                        crc = (crc >> 1) ^ (0x82f63b78u & (0u - (crc & 1u)));
+                    }
+                    result[0][i] = crc;
+                }
+                for(std::size_t slice = 1; slice < result.size(); ++slice)
+                {
+                    for(std::size_t i = 0; i < 256; ++i)
+                    {
+                        result[slice][i] = (result[slice - 1][i] >> 8) ^ result[0][result[slice - 1][i] & 0xff];
+                    }
+                }
+                return result;
+            }();
+            return table;
+        }
+
+        inline std::uint32_t crc32cScalar(std::uint32_t crc, const char* data, std::size_t size)
+        {
+            const auto& table = serialization::detail::crc32cTable();
+            const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+            crc = ~crc;
+            for(; size >= 8; size -= 8, bytes += 8)
+            {
+                std::uint64_t word = 0;
+                for(int i = 0; i < 8; ++i)
+                {
+                    word |= static_cast<std::uint64_t>(bytes[i]) << (8 * i);
+                }
+                word ^= crc;
+                crc = table[7][word & 0xff] ^ table[6][(word >> 8) & 0xff] ^ table[5][(word >> 16) & 0xff]
+                    ^ table[4][(word >> 24) & 0xff] ^ table[3][(word >> 32) & 0xff] ^ table[2][(word >> 40) & 0xff]
+                    ^ table[1][(word >> 48) & 0xff] ^ table[0][word >> 56];
+            }
+            for(; size > 0; --size)
+            {
+                crc = (crc >> 8) ^ table[0][(crc ^ *bytes++) & 0xff];
+            }
+            return ~crc;
+        }
+
+#if defined(SERIALIZATION_SSE42)
+        SERIALIZATION_SSE42 inline std::uint32_t crc32cSse42(std::uint32_t crc, const char* data, std::size_t size)
+        {
+            std::uint64_t state = ~crc;
+            for(; size >= 8; size -= 8, data += 8)
+            {
+                std::uint64_t word;
+                std::memcpy(&word, data, sizeof(word));
+                state = _mm_crc32_u64(state, word);
+            }
+            auto result = static_cast<std::uint32_t>(state);
+            for(; size > 0; --size)
+            {
+                result = _mm_crc32_u8(result, static_cast<unsigned char>(*data++));
+            }
+            return ~result;
+        }
+#endif
+
+        using Crc32cFunction = std::uint32_t (*)(std::uint32_t, const char*, std::size_t);
+
+        inline Crc32cFunction selectCrc32c()
+        {
+#if defined(SERIALIZATION_SSE42)
+            __builtin_cpu_init();
+            if(__builtin_cpu_supports("sse4.2"))
+            {
+                return crc32cSse42;
+            }
+#endif
+            return crc32cScalar;
+        }
+
+        /**
+         * Continues crc over bytes. Start with 0.
+         */
+        inline std::uint32_t crc32c(std::string_view bytes, std::uint32_t crc = 0)
+        {
+            static const Crc32cFunction update = selectCrc32c();
+            return update(crc, bytes.data(), bytes.size());
+        }
+
+        inline void appendCrc32c(std::string& output, std::string_view bytes)
+        {
+            const std::uint32_t crc = serialization::detail::crc32c(bytes);
+            for(int i = 0; i < 4; ++i)
+            {
+                output.push_back(static_cast<char>(crc >> (8 * i)));
+            }
+        }
+
+        inline void checkCrc32c(std::string_view bytes, const char* stored)
+        {
+            std::uint32_t crc = 0;
+            for(int i = 0; i < 4; ++i)
+            {
+                crc |= static_cast<std::uint32_t>(static_cast<unsigned char>(stored[i])) << (8 * i);
+            }
+            if(crc != serialization::detail::crc32c(bytes))
+            {
+                throw std::runtime_error("serialization: checksum mismatch");
+            }
+        }
+
+        /**
+         * BLOCK COMPRESSION *
+         * Compressed data starts with COMPRESSED_MAGIC and a flags byte, followed by blocks of at most
+         * COMPRESSED_BLOCK bytes. Every block is compressed on its own, so data can be compressed and
+         * decompressed while it streams. A block is its method, its size and its stored size as varints, then
+         * the stored bytes. A block of size 0 ends the data. With COMPRESSED_CHECKSUM set, every block except
+         * that end marker is followed by the CRC32C of its stored bytes, so corruption is caught before a block is
+         * decoded.
+         */
+        inline constexpr char COMPRESSED_MAGIC[4] = { 'S', 'P', 'Z', '1' };
+        inline constexpr std::size_t COMPRESSED_BLOCK = 1 << 16;
+        inline constexpr char COMPRESSED_CHECKSUM = 0x01;
+
+        enum class BlockMethod : char
+        {
+            Stored = 0,
+            Lz = 1,
+            Zstd = 2
+        };
+
+        inline std::uint32_t load32(const char* data)
+        {
+            std::uint32_t value;
+            std::memcpy(&value, data, sizeof(value));
+            return value;
+        }
+
+        inline void writeLzLength(std::string& output, std::size_t length)
+        {
+            for(; length >= 255; length -= 255)
+            {
+                output.push_back(static_cast<char>(255));
+            }
+            output.push_back(static_cast<char>(length));
+        }
+
+        /**
+         * Reads a varint written by writeVarint from input at position, and moves position past it.
+         */
+        inline std::uint64_t readVarint(std::string_view input, std::size_t& position)
+        {
+            std::uint64_t value = 0;
+            for(int shift = 0; shift < 64 && position < input.size(); shift += 7)
+            {
+                const auto byte = static_cast<unsigned char>(input[position++]);
+                value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+                if(!(byte & 0x80))
+                {
+                    return value;
+                }
+            }
+            throw std::runtime_error("serialization: malformed varint");
+        }
+
+        /**
+         * LZ block codec, in the style of LZ4. A block is a series of sequences: a token, literal bytes, then a
+         * match of earlier bytes as 16-bit offset back. The token holds the literal count in its high and the
+         * match length minus 4 in its low four bits, where 15 means that bytes follow which are added to it, up
+         * to the first one below 255. The last sequence has no match.
+         */
+        inline void writeLzSequence(std::string& output, const char* literals, std::size_t count, std::size_t offset, std::size_t length)
+        {
+            const std::size_t match = length ? length - 4 : 0;
+            output.push_back(static_cast<char>((std::min<std::size_t>(count, 15) << 4) | std::min<std::size_t>(match, 15)));
+            if(count >= 15)
+            {
+                serialization::detail::writeLzLength(output, count - 15);
+            }
+            output.append(literals, count);
+            if(length)
+            {
+                output.push_back(static_cast<char>(offset));
+                output.push_back(static_cast<char>(offset >> 8));
+                if(match >= 15)
+                {
+                    serialization::detail::writeLzLength(output, match - 15);
+                }
+            }
+        }
+
+        /**
+         * Finds matches through a hash table of the last position of every 4 byte sequence. Matches are extended
+         * 8 bytes at a time, and the search skips ahead faster the longer it finds nothing, so incompressible
+         * data passes quickly.
+         */
+        inline void compressLz(std::string& output, std::string_view input)
+        {
+            constexpr unsigned HASH_BITS = 14;
+            std::vector<std::uint32_t> table(1 << HASH_BITS);
+            const char* data = input.data();
+            const std::size_t size = input.size();
+            std::size_t anchor = 0;
+            std::size_t misses = 0;
+            for(std::size_t i = 0; i + 4 <= size;)
+            {
+                const std::uint32_t sequence = serialization::detail::load32(data + i);
+                const std::uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+                const std::size_t candidate = table[hash];
+                table[hash] = static_cast<std::uint32_t>(i);
+                if(candidate >= i || i - candidate > 0xffff || serialization::detail::load32(data + candidate) != sequence)
+                {
+                    i += 1 + (misses++ >> 5);
+                    continue;
+                }
+                std::size_t length = 4;
+                while(i + length + 8 <= size)
+                {
+                    const std::uint64_t difference = serialization::detail::decodeLittleEndian<std::uint64_t>(data + i + length) ^
+                        serialization::detail::decodeLittleEndian<std::uint64_t>(data + candidate + length);
+                    if(difference)
+                    {
+                        length += static_cast<std::size_t>(serialization::detail::countTrailingZeros(difference) / 8);
+                        break;
+                    }
+                    length += 8;
+                }
+                if(i + length + 8 > size)
+                {
+                    while(i + length < size && data[i + length] == data[candidate + length])
+                    {
+                        length++;
+                    }
+                }
+                serialization::detail::writeLzSequence(output, data + anchor, i - anchor, i - candidate, length);
+                i += length;
+                anchor = i;
+                misses = 0;
+            }
+            serialization::detail::writeLzSequence(output, data + anchor, size - anchor, 0, 0);
+        }
+
+        /**
+         * Appends the size bytes encoded in input to output. Output is resized with some slack, so short
+         * literals and matches can be copied in fixed steps of 16 bytes, which may write past their end.
+         */
+        inline void decompressLz(std::string& output, std::string_view input, std::size_t size)
+        {
+            constexpr std::size_t SLACK = 16;
+            auto corrupt = []()
+            {
+                return std::runtime_error("serialization: corrupt compressed block");
+            };
+            const std::size_t begin = output.size();
+            output.resize(begin + size + SLACK);
+            char* target = &output[begin];
+            std::size_t written = 0;
+            std::size_t position = 0;
+            auto readLength = [&](std::size_t length)
+            {
+                if(length == 15)
+                {
+                    unsigned char byte;
+                    do
+                    {
+                        if(position >= input.size())
+                        {
+                            throw corrupt();
+                        }
+                        byte = static_cast<unsigned char>(input[position++]);
+                        length += byte;
+                    }
+                    while(byte == 255);
+                }
+                return length;
+            };
+            while(true)
+            {
+                if(position >= input.size())
+                {
+                    throw corrupt();
+                }
+                const auto token = static_cast<unsigned char>(input[position++]);
+                const std::size_t count = readLength(token >> 4);
+                if(count > input.size() - position || count > size - written)
+                {
+                    throw corrupt();
+                }
+                if(count <= SLACK && input.size() - position >= SLACK)
+                {
+                    std::memcpy(target + written, input.data() + position, SLACK);
+                }
+                else
+                {
+                    std::memcpy(target + written, input.data() + position, count);
+                }
+                position += count;
+                written += count;
+                if(written == size)
+                {
+                    if(position != input.size())
+                    {
+                        throw corrupt();
+                    }
+                    output.resize(begin + size);
+                    return;
+                }
+                if(input.size() - position < 2)
+                {
+                    throw corrupt();
+                }
+                const std::size_t offset = static_cast<unsigned char>(input[position]) | static_cast<std::size_t>(static_cast<unsigned char>(input[position + 1])) << 8;
+                position += 2;
+                const std::size_t length = readLength(token & 15) + 4;
+                if(offset == 0 || offset > written || length > size - written)
+                {
+                    throw corrupt();
+                }
+                char* match = target + written;
+                if(offset >= SLACK)
+                {
+                    for(std::size_t i = 0; i < length; i += SLACK)
+                    {
+                        std::memcpy(match + i, match + i - offset, SLACK);
+                    }
+                }
+                else if(offset >= length)
+                {
+                    std::memcpy(match, match - offset, length);
+                }
+                else
+                {
+                    // the match repeats bytes it is still writing
+                    for(std::size_t i = 0; i < length; i++)
+                    {
+                        match[i] = match[i - offset];
+                    }
+                }
+                written += length;
+            }
+        }
+
+        /**
+         * Appends block compressed with compression to output, or stored as it is if that is not smaller.
+         * scratch holds the compressed bytes, so it can be reused between blocks.
+         */
+        inline void appendBlock(std::string& output, std::string_view block, Compression compression, Checksum checksum, std::string& scratch)
+        {
+            BlockMethod method = BlockMethod::Stored;
+            scratch.clear();
+            if(compression == Compression::Lz)
+            {
+                serialization::detail::compressLz(scratch, block);
+                method = BlockMethod::Lz;
+            }
+            else if(compression == Compression::Zstd)
+            {
+#if defined(SERIALIZATION_ZSTD)
+                scratch.resize(ZSTD_compressBound(block.size()));
+                const std::size_t size = ZSTD_compress(&scratch[0], scratch.size(), block.data(), block.size(), ZSTD_CLEVEL_DEFAULT);
+                if(ZSTD_isError(size))
+                {
+                    throw std::runtime_error(std::string("serialization: ") + ZSTD_getErrorName(size));
+                }
+                scratch.resize(size);
+                method = BlockMethod::Zstd;
+#else
+                throw std::invalid_argument("serialization: Compression::Zstd needs SERIALIZATION_ZSTD to be defined");
+#endif
+            }
+            if(scratch.size() >= block.size())
+            {
+                method = BlockMethod::Stored;
+            }
+            const std::string_view stored = method == BlockMethod::Stored ? block : std::string_view(scratch);
+            output.push_back(static_cast<char>(method));
+            serialization::detail::writeVarint(output, block.size());
+            serialization::detail::writeVarint(output, stored.size());
+            output.append(stored);
+            if(checksum == Checksum::Crc32c)
+            {
+                serialization::detail::appendCrc32c(output, stored);
+            }
+        }
+
+        /**
+         * Appends the size bytes held by a block stored with method to output.
+         */
+        inline void decodeBlock(std::string& output, BlockMethod method, std::string_view stored, std::size_t size)
+        {
+            switch(method)
+            {
+                case BlockMethod::Stored:
+                    if(stored.size() != size)
+                    {
+                        throw std::runtime_error("serialization: corrupt compressed block");
+                    }
+                    output.append(stored);
+                    break;
+                case BlockMethod::Lz:
+                    serialization::detail::decompressLz(output, stored, size);
+                    break;
+                case BlockMethod::Zstd:
+                {
+#if defined(SERIALIZATION_ZSTD)
+                    const std::size_t begin = output.size();
+                    output.resize(begin + size);
+                    const std::size_t written = ZSTD_decompress(&output[begin], size, stored.data(), stored.size());
+                    if(ZSTD_isError(written) || written != size)
+                    {
+                        throw std::runtime_error("serialization: corrupt compressed block");
+                    }
+                    break;
+#else
+                    throw std::runtime_error("serialization: reading zstd compressed data needs SERIALIZATION_ZSTD to be defined");
+#endif
+                }
+                default:
+                    throw std::runtime_error("serialization: unknown compression method");
+            }
+        }
+
+        inline bool isCompressed(std::string_view bytes)
+        {
+            return bytes.size() > sizeof(COMPRESSED_MAGIC) && bytes.substr(0, sizeof(COMPRESSED_MAGIC)) == std::string_view(COMPRESSED_MAGIC, sizeof(COMPRESSED_MAGIC));
+        }
+
+        inline void appendCompressedHeader(std::string& output, Checksum checksum)
+        {
+            output.append(COMPRESSED_MAGIC, sizeof(COMPRESSED_MAGIC));
+            output.push_back(checksum == Checksum::Crc32c ? COMPRESSED_CHECKSUM : 0);
+        }
+
+        /**
+         * Checks the magic and the flags byte in front of compressed data, returns the checksum of its blocks.
+         */
+        inline Checksum checkCompressedHeader(std::string_view header)
+        {
+            if(!serialization::detail::isCompressed(header))
+            {
+                throw std::runtime_error("serialization: data is not compressed");
+            }
+            const char flags = header[sizeof(COMPRESSED_MAGIC)];
+            if(flags & ~COMPRESSED_CHECKSUM)
+            {
+                throw std::runtime_error("serialization: compressed data uses unknown flags");
+            }
+            return flags & COMPRESSED_CHECKSUM ? Checksum::Crc32c : Checksum::None;
+        }
+
+        /**
+         * Compresses what is written to it into output, one block at a time, so neither the data nor its
+         * compressed form have to be held in memory as a whole. finish writes the last block and the end.
+         */
+        class BlockWriter
+        {
+        private:
+            std::ostream& output;
+            Compression compression;
+            Checksum checksum;
+            std::string block;
+            std::string encoded;
+            std::string scratch;
+
+            void flush(std::string_view bytes)
+            {
+                encoded.clear();
+                serialization::detail::appendBlock(encoded, bytes, compression, checksum, scratch);
+                output.write(encoded.data(), static_cast<std::streamsize>(encoded.size()));
+            }
+
+        public:
+            BlockWriter(std::ostream& anOutput, Compression aCompression, Checksum aChecksum = Checksum::None)
+            : output(anOutput), compression(aCompression), checksum(aChecksum)
+            {
+                encoded.clear();
+                serialization::detail::appendCompressedHeader(encoded, checksum);
+                output.write(encoded.data(), static_cast<std::streamsize>(encoded.size()));
+            }
+
+            void write(std::string_view bytes)
+            {
+                while(!bytes.empty())
+                {
+                    if(block.empty() && bytes.size() >= COMPRESSED_BLOCK)
+                    {
+                        flush(bytes.substr(0, COMPRESSED_BLOCK));
+                        bytes.remove_prefix(COMPRESSED_BLOCK);
+                        continue;
+                    }
+                    const std::size_t size = std::min(bytes.size(), COMPRESSED_BLOCK - block.size());
+                    block.append(bytes.data(), size);
+                    bytes.remove_prefix(size);
+                    if(block.size() == COMPRESSED_BLOCK)
+                    {
+                        flush(block);
+                        block.clear();
+                    }
+                }
+            }
+            void finish()
+            {
+                if(!block.empty())
+                {
+                    flush(block);
+                    block.clear();
+                }
+                const char end[3] = { static_cast<char>(BlockMethod::Stored), 0, 0 };
+                output.write(end, sizeof(end));
+            }
+        };
+
+        /**
+         * Reads data written by BlockWriter one block at a time, and checks their checksums if they have any.
+         */
+        class BlockReader
+        {
+        private:
+            std::istream& input;
+            std::string stored;
+            Checksum checksum = Checksum::None;
+            bool ended = false;
+
+            std::uint64_t readVarint()
+            {
+                std::uint64_t value = 0;
+                for(int shift = 0; shift < 64; shift += 7)
+                {
+                    const int byte = input.get();
+                    if(byte == std::char_traits<char>::eof())
+                    {
+                        throw std::runtime_error("serialization: compressed data ends early");
+                    }
+                    value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+                    if(!(byte & 0x80))
+                    {
+                        return value;
+                    }
+                }
+                throw std::runtime_error("serialization: malformed varint");
+            }
+
+        public:
+            explicit BlockReader(std::istream& anInput)
+            : input(anInput)
+            {
+                char header[sizeof(COMPRESSED_MAGIC) + 1] = {};
+                input.read(header, sizeof(header));
+                checksum = serialization::detail::checkCompressedHeader(std::string_view(header, static_cast<std::size_t>(input.gcount())));
+            }
+
+            bool checksummed() const
+            {
+                return checksum == Checksum::Crc32c;
+            }
+
+            /**
+             * Appends the next block to output, returns false after the last one.
+             */
+            bool next(std::string& output)
+            {
+                if(ended)
+                {
+                    return false;
+                }
+                const int method = input.get();
+                if(method == std::char_traits<char>::eof())
+                {
+                    throw std::runtime_error("serialization: compressed data ends early");
+                }
+                const std::uint64_t size = readVarint();
+                const std::uint64_t storedSize = readVarint();
+                if(size == 0)
+                {
+                    ended = true;
+                    return false;
+                }
+                if(size > COMPRESSED_BLOCK || storedSize > size)
+                {
+                    throw std::runtime_error("serialization: corrupt compressed block");
+                }
+                const std::size_t trailer = checksum == Checksum::Crc32c ? 4 : 0;
+                stored.resize(static_cast<std::size_t>(storedSize) + trailer);
+                if(!input.read(&stored[0], static_cast<std::streamsize>(stored.size())))
+                {
+                    throw std::runtime_error("serialization: compressed data ends early");
+                }
+                const std::string_view bytes(stored.data(), static_cast<std::size_t>(storedSize));
+                if(trailer)
+                {
+                    serialization::detail::checkCrc32c(bytes, stored.data() + storedSize);
+                }
+                serialization::detail::decodeBlock(output, static_cast<BlockMethod>(method), bytes, static_cast<std::size_t>(size));
+                return true;
+            }
+        };
+
+        /**
+         * Writes bytes to the file as they are, or in blocks if they are compressed or checksummed.
+         */
+        inline bool writeFile(const std::string& filepath, std::string_view bytes, Compression compression, Checksum checksum)
+        {
+            std::ofstream file(filepath, std::ios::binary);
+            if(compression == Compression::None && checksum == Checksum::None)
+            {
+                file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+            }
+            else
+            {
+                BlockWriter writer(file, compression, checksum);
+                writer.write(bytes);
+                writer.finish();
+            }
+            return static_cast<bool>(file);
+        }
+
+        /**
+         * Reads the file into bytes, block by block if it was written with compression or checksum, as the caller
+         * tells. The contents are never inspected to decide, as plain archives may start with any bytes. Throws if
+         * a block is corrupt, or if checksums are asked for and the blocks carry none.
+         */
+        inline bool readFile(const std::string& filepath, std::string& bytes, Compression compression, Checksum checksum)
+        {
+            std::ifstream file(filepath, std::ios::binary);
+            if(!file)
+            {
+                return false;
+            }
+            bytes.clear();
+            if(compression == Compression::None && checksum == Checksum::None)
+            {
+                bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+                return true;
+            }
+            BlockReader reader(file);
+            if(checksum == Checksum::Crc32c && !reader.checksummed())
+            {
+                throw std::runtime_error("serialization: file was saved without checksums");
+            }
+            while(reader.next(bytes))
+            {
+            }
+            return true;
+        }
+
+        /**
+         * RECORD STREAMS *
+         * A record stream starts with RECORD_MAGIC and a flags byte, followed by records, each of which is its
+         * size as varint and the bytes of an archive holding only that record. With RECORD_CHECKSUM set, every
+         * record is followed by the CRC32C of its bytes. Like any file, the whole stream can be compressed and
+         * checksummed in blocks instead, but then it can't be appended to.
+         */
+        inline constexpr char RECORD_MAGIC[4] = { 'S', 'P', 'R', '1' };
+        inline constexpr char RECORD_CHECKSUM = 0x01;
+        inline constexpr std::size_t RECORD_WINDOW = 1 << 20;
+
+        /**
+         * Reads a file piece by piece, through a BlockReader if it was written in blocks. Only the bytes that were
+         * not consumed yet are kept, so it holds about a window, or the largest record requested, at a time.
+         */
+        class WindowReader
+        {
+        private:
+            /** On the heap, as blocks refers to it. */
+            std::unique_ptr<std::ifstream> file;
+            std::optional<BlockReader> blocks;
+            std::string buffer;
+            std::size_t offset = 0;
+            std::uint64_t consumed = 0;
+            std::size_t window;
+
+            bool readMore()
+            {
+                if(blocks)
+                {
+                    return blocks->next(buffer);
+                }
+                const std::size_t size = buffer.size();
+                buffer.resize(size + window);
+                file->read(&buffer[size], static_cast<std::streamsize>(window));
+                buffer.resize(size + static_cast<std::size_t>(file->gcount()));
+                return buffer.size() > size;
+            }
+
+        public:
+            WindowReader(const std::string& filepath, std::size_t aWindow)
+            : file(std::make_unique<std::ifstream>(filepath, std::ios::binary)), window(std::max<std::size_t>(aWindow, 64))
+            {
+                if(!*file)
+                {
+                    throw std::runtime_error("serialization: cannot open " + filepath);
+                }
+                char header[sizeof(COMPRESSED_MAGIC) + 1];
+                const std::size_t size = static_cast<std::size_t>(file->read(header, sizeof(header)).gcount());
+                file->clear();
+                file->seekg(0);
+                if(serialization::detail::isCompressed(std::string_view(header, size)))
+                {
+                    blocks.emplace(*file);
+                }
+            }
+
+            /**
+             * Makes at least size bytes available, returns false if the file ends before.
+             */
+            bool request(std::size_t size)
+            {
+                if(buffer.size() - offset >= size)
+                {
+                    return true;
+                }
+                buffer.erase(0, offset);
+                offset = 0;
+                while(buffer.size() < size)
+                {
+                    if(!readMore())
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            std::string_view available() const
+            {
+                return std::string_view(buffer).substr(offset);
+            }
+            void consume(std::size_t size)
+            {
+                offset += size;
+                consumed += size;
+            }
+            /**
+             * Returns how many bytes were consumed, which is the offset into the file unless it is compressed.
+             */
+            std::uint64_t tell() const
+            {
+                return consumed;
+            }
+            bool compressed() const
+            {
+                return blocks.has_value();
+            }
+        };
+
+        inline void appendRecordHeader(std::string& output, Checksum checksum)
+        {
+            output.append(RECORD_MAGIC, sizeof(RECORD_MAGIC));
+            output.push_back(checksum == Checksum::Crc32c ? RECORD_CHECKSUM : 0);
+        }
+
+        /**
+         * Checks the header of a record stream, returns whether its records are followed by a checksum.
+         */
+        inline bool readRecordHeader(WindowReader& reader, const std::string& filepath)
+        {
+            constexpr std::size_t size = sizeof(RECORD_MAGIC) + 1;
+            if(!reader.request(size) || reader.available().substr(0, sizeof(RECORD_MAGIC)) != std::string_view(RECORD_MAGIC, sizeof(RECORD_MAGIC)))
+            {
+                throw std::runtime_error("serialization: " + filepath + " is not a record stream");
+            }
+            const char flags = reader.available()[sizeof(RECORD_MAGIC)];
+            if(flags & ~RECORD_CHECKSUM)
+            {
+                throw std::runtime_error("serialization: record stream uses unknown flags");
+            }
+            reader.consume(size);
+            return flags & RECORD_CHECKSUM;
+        }
+
+        enum class RecordRead
+        {
+            Record,
+            End,
+            /** The stream ends inside the record, eg. because writing it was interrupted. */
+            Truncated
+        };
+
+        /**
+         * Reads the next record of a record stream into record, which stays valid until the next read.
+         * Throws if its checksum doesn't match.
+         */
+        inline RecordRead readRecord(WindowReader& reader, bool checksummed, std::string_view& record)
+        {
+            if(!reader.request(1))
+            {
+                return RecordRead::End;
+            }
+            reader.request(10);
+            const std::string_view available = reader.available();
+            std::size_t position = 0;
+            while(position < available.size() && position < 10 && (available[position] & 0x80))
+            {
+                position++;
+            }
+            if(position == available.size())
+            {
+                return RecordRead::Truncated;
+            }
+            position = 0;
+            const std::uint64_t size = serialization::detail::readVarint(available, position);
+            const std::size_t trailer = checksummed ? 4 : 0;
+            if(size > std::numeric_limits<std::size_t>::max() - position - trailer)
+            {
+                throw std::runtime_error("serialization: corrupt record size");
+            }
+            if(!reader.request(position + static_cast<std::size_t>(size) + trailer))
+            {
+                return RecordRead::Truncated;
+            }
+            record = reader.available().substr(position, static_cast<std::size_t>(size));
+            if(checksummed)
+            {
+                serialization::detail::checkCrc32c(record, record.data() + record.size());
+            }
+            reader.consume(position + static_cast<std::size_t>(size) + trailer);
+            return RecordRead::Record;
+        }
+    }
+
+    /**
+     * Takes an IArchive and writes the contained properties to the object. Object has to have
+     * the SERIALIZATION-macro.
+     */
+    template<typename IArchive, typename T>
+    bool deserialize(const IArchive& archive, T &obj)
+    {
+        static_assert(detail::is_archive<IArchive>::value, "deserialize: IArchive is not an archive.");
+        detail::rewind(archive, 0);
+#if defined(SERIALIZATION_INSTRUMENTATION)
+        const instrumentation::Measurement measurement(archive.bytesRead());
+#endif
+        detail::setData<0>(obj, archive);
+#if defined(SERIALIZATION_INSTRUMENTATION)
+        measurement.report(instrumentation::Operation::Deserialize, typeid(T).name(), nullptr, archive.bytesRead());
+#endif
+        return true;
+    };
+
+    /**
+     * Like deserialize, but only writes the properties selected by fields. The others are skipped without being
+     * decoded and keep their value.
+     */
+    template<typename IArchive, typename T, auto... members>
+    bool deserialize(const IArchive& archive, T &obj, Fields<members...> selection)
+    {
+        static_assert(detail::is_archive<IArchive>::value, "deserialize: IArchive is not an archive.");
+        static_assert(((detail::propertyIndex<T>(members) < std::tuple_size<decltype(T::PROPERTIES)>::value) && ...),
+            "fields: every member has to be part of the PROPERTIES");
+        detail::rewind(archive, 0);
+#if defined(SERIALIZATION_INSTRUMENTATION)
+        const instrumentation::Measurement measurement(archive.bytesRead());
+#endif
+        detail::setFields<0, decltype(selection)>(obj, archive);
+#if defined(SERIALIZATION_INSTRUMENTATION)
+        measurement.report(instrumentation::Operation::Deserialize, typeid(T).name(), nullptr, archive.bytesRead());
+#endif
+        return true;
+    }
+
+    /**
+     * Takes an object with the SERIALIZE-macro and stores it's properties in an IArchive.
+     */
+    template<typename IArchive, typename T>
+    IArchive serialize(const T &obj)
+    {
+        static_assert(detail::is_archive<IArchive>::value, "serialize: IArchive is not an archive.");
+        IArchive archive;
+#if defined(SERIALIZATION_INSTRUMENTATION)
+        const instrumentation::Measurement measurement(archive.bytesWritten());
+#endif
+        detail::getData<0>(obj, archive);
+#if defined(SERIALIZATION_INSTRUMENTATION)
+        measurement.report(instrumentation::Operation::Serialize, typeid(T).name(), nullptr, archive.bytesWritten());
+#endif
+        return archive;
+    }
+
+    /**
+     * Takes a vector of objects with the SERIALIZE-macro and stores them as one batch. If chunkSize is not 0,
+     * the archive additionally stores the offset of every chunkSize-th record, so it can be decoded in parallel.
+     */
+    template<typename IArchive, typename T>
+    IArchive serializeBatch(const std::vector<T>& objects, std::size_t chunkSize = 0)
+    {
+        IArchive archive;
+        archive.storeBatch(objects, chunkSize);
+        return archive;
+    }
+
+    /**
+     * Takes an IArchive created by serializeBatch and replaces the contents of objects with the stored records.
+     * Indexed batches are decoded on up to threads threads (0 = one per hardware thread).
+     */
+    template<typename IArchive, typename T>
+    bool deserializeBatch(const IArchive& archive, std::vector<T>& objects, unsigned threads = 0)
+    {
+        detail::rewind(archive, 0);
+        archive.retrieveBatch(objects, threads);
+        return true;
+    }
+
+    /**
+     * Wraps a property whose value rarely changes, and keeps its encoding for every archive type it was stored
+     * with. Later stores copy the kept bytes instead of encoding the value again. Changing the value through
+     * modify, assigning it or calling invalidate increments the version, which discards the kept bytes.
+     */
+    template<typename T>
+    class Cached
+    {
+    private:
+        struct Encoding
+        {
+            const void* archive;
+            std::uint64_t version;
+            std::string bytes;
+        };
+
+        T value;
+        std::uint64_t version = 0;
+        mutable std::vector<Encoding> encodings;
+        mutable std::mutex mutex;
+
+    public:
+        static_assert(detail::has_properties<T>::value, "Cached: T has to have the SERIALIZE-macro");
+        using Type = T;
+
+        Cached() = default;
+        Cached(T aValue)
+        : value(std::move(aValue))
+        {
+            // empty
+        }
+        Cached(const Cached& other)
+        : value(other.value)
+        {
+            // empty
+        }
+        Cached& operator=(const Cached& other)
+        {
+            value = other.value;
+            invalidate();
+            return *this;
+        }
+        Cached& operator=(T aValue)
+        {
+            value = std::move(aValue);
+            invalidate();
+            return *this;
+        }
+
+        const T& get() const
+        {
+            return value;
+        }
+        const T* operator->() const
+        {
+            return &value;
+        }
+        /**
+         * Returns the value to change it, the kept encodings are discarded.
+         */
+        T& modify()
+        {
+            invalidate();
+            return value;
+        }
+        void invalidate()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            version++;
+        }
+        std::uint64_t getVersion() const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return version;
+        }
+
+        /**
+         * Appends the encoding for Archive to output, calling encode() for it if there is no current one.
+         */
+        template<typename Archive, typename Encode>
+        void appendEncoded(std::string& output, Encode&& encode) const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            const void* archive = &detail::archive_tag<Archive>;
+            auto encoding = std::find_if(encodings.begin(), encodings.end(), [&](const Encoding& candidate)
+            {
+                return candidate.archive == archive;
+            });
+            if(encoding == encodings.end())
+            {
+                encodings.push_back(Encoding { archive, version, encode(value) });
+                encoding = encodings.end() - 1;
+            }
+            else if(encoding->version != version)
+            {
+                encoding->bytes = encode(value);
+                encoding->version = version;
+            }
+            output += encoding->bytes;
+        }
+    };
+
+    /**
+     * A std::vector of records that archives store column by column: all values of the first property, then all
+     * values of the second, and so on. Values of one property are stored next to each other, and every column can
+     * be skipped on its own, so retrieveColumn reads one property of all records without decoding the others.
+     */
+    template<typename T>
+    class Columns : public std::vector<T>
+    {
+    public:
+        static_assert(detail::has_properties<T>::value, "Columns: T has to have the SERIALIZE-macro");
+        static_assert(std::tuple_size<decltype(T::PROPERTIES)>::value > 0, "Columns: T needs at least one property");
+        using Records = std::vector<T>;
+        using Records::Records;
+
+        Columns() = default;
+        Columns(Records records)
+        : Records(std::move(records))
+        {
+            // empty
+        }
+    };
+
+    /**
+     * Stores only the properties of current that differ from baseline, nested objects are compared property by
+     * property. applyDelta turns baseline into current again.
+     */
+    template<typename IArchive, typename T>
+    IArchive serializeDelta(const T& current, const T& baseline)
+    {
+        IArchive archive;
+        detail::getDelta(detail::Comparison<T> { current, baseline }, archive);
+        return archive;
+    }
+
+    /**
+     * Stores only the properties of a Trackable that were marked as dirty, then clears them. The result is a
+     * delta, which applyDelta writes to another object.
+     */
+    template<typename IArchive, typename T>
+    IArchive serializeDirty(T& object)
+    {
+        IArchive archive;
+        detail::getDelta(detail::DirtyFields<T> { object, !std::is_base_of<Trackable, T>::value }, archive);
+        detail::clearDirty(object);
+        return archive;
+    }
+
+    /**
+     * Marks the property storing member as dirty. T has to be derived from Trackable and the type whose
+     * PROPERTIES are serialized, as the mask follows their order.
+     */
+    template<auto member, typename T>
+    void markDirty(T& object)
+    {
+        constexpr std::size_t index = detail::propertyIndex<T>(member);
+        static_assert(std::is_base_of<Trackable, T>::value, "markDirty: the object has to be derived from Trackable");
+        static_assert(index < std::tuple_size<decltype(T::PROPERTIES)>::value, "markDirty: member is not part of the PROPERTIES");
+        static_assert(index < 64, "markDirty: only the first 64 properties can be tracked");
+        object.Trackable::setDirty(index);
+    }
+
+    /**
+     * Assigns value to member and marks it as dirty.
+     */
+    template<auto member, typename T, typename Value>
+    void set(T& object, Value&& value)
+    {
+        object.*member = std::forward<Value>(value);
+        serialization::markDirty<member>(object);
+    }
+
+    /**
+     * Takes an IArchive created by serializeDelta and writes the changed properties to the object.
+     */
+    template<typename IArchive, typename T>
+    bool applyDelta(const IArchive& archive, T &obj)
+    {
+        detail::rewind(archive, 0);
+        detail::setDelta(obj, archive);
+        return true;
+    }
+
+    /**
+     * An object inside an archive, whose properties are decoded on their first access and cached. The archive
+     * has to outlive it. Properties that precede the accessed one are skipped, not decoded.
+     */
+    template<typename IArchive, typename T>
+    class LazyObject
+    {
+    private:
+        using Properties = std::decay_t<decltype(T::PROPERTIES)>;
+        static constexpr std::size_t COUNT = std::tuple_size<Properties>::value;
+
+        const IArchive& archive;
+        /** Where each property starts, only the first known of them are set. */
+        mutable std::array<typename IArchive::Cursor, COUNT + 1> cursors {};
+        mutable std::size_t known = 1;
+        mutable typename detail::property_cache<Properties>::type cache;
+
+        template<std::size_t index>
+        void skipProperty() const
+        {
+            constexpr auto property = std::get<index>(T::PROPERTIES);
+            using Type = typename decltype(property)::Type;
+            if constexpr(detail::holdsShared<Type>())
+            {
+                // kept, so its shared objects are read once and later properties can refer to them
+                std::get<index>(cache).emplace(detail::retrieveProperty(archive, property));
+            }
+            else
+            {
+                archive.template skip<Type>(property.name);
+            }
+            cursors[index + 1] = archive.tell();
+            known = index + 2;
+        }
+        /**
+         * Finds where the properties up to the last one in indices start.
+         */
+        template<std::size_t... indices>
+        void locate(std::index_sequence<indices...>) const
+        {
+            archive.seek(cursors[known - 1]);
+            ((indices + 1 >= known ? skipProperty<indices>() : void()), ...);
+        }
+
+    public:
+        explicit LazyObject(const IArchive& aArchive)
+        : archive(aArchive)
+        {
+            cursors[0] = archive.tell();
+        }
+
+        /**
+         * Returns the value of the property storing member.
+         */
+        template<auto member>
+        const auto& get() const
+        {
+            constexpr std::size_t index = detail::propertyIndex<T>(member);
+            static_assert(index < COUNT, "LazyObject: member is not part of the PROPERTIES");
+            constexpr auto property = std::get<index>(T::PROPERTIES);
+            auto& value = std::get<index>(cache);
+            if(!value)
+            {
+                const typename IArchive::Cursor previous = archive.tell();
+                try
+                {
+                    if(known <= index)
+                    {
+                        locate(std::make_index_sequence<index>());
+                    }
+                    archive.seek(cursors[index]);
+                    value.emplace(detail::retrieveProperty(archive, property));
+                    if(known == index + 1)
+                    {
+                        cursors[index + 1] = archive.tell();
+                        known = index + 2;
+                    }
+                }
+                catch(...)
+                {
+                    archive.seek(previous);
+                    throw;
+                }
+                archive.seek(previous);
+            }
+            return *value;
+        }
+    };
+
+    /**
+     * Returns a LazyObject for the T stored in archive, without decoding any of its properties yet.
+     */
+    template<typename T, typename IArchive>
+    LazyObject<IArchive, T> lazyDeserialize(const IArchive& archive)
+    {
+        detail::rewind(archive, 0);
+        return LazyObject<IArchive, T>(archive);
+    }
+
+    /**
+     * Compresses bytes in independent blocks of 64 KiB, eg. the storage of an archive before sending it. With a
+     * checksum, decompress rejects blocks that were changed on the way.
+     */
+    inline std::string compress(std::string_view bytes, Compression compression = Compression::Lz, Checksum checksum = Checksum::None)
+    {
+        std::string result;
+        detail::appendCompressedHeader(result, checksum);
+        std::string scratch;
+        for(std::size_t offset = 0; offset < bytes.size(); offset += detail::COMPRESSED_BLOCK)
+        {
+            detail::appendBlock(result, bytes.substr(offset, detail::COMPRESSED_BLOCK), compression, checksum, scratch);
+        }
+        result.append(3, '\0');
+        return result;
+    }
+
+    /**
+     * Returns the bytes compress was called with.
+     */
+    inline std::string decompress(std::string_view bytes)
+    {
+        const std::size_t trailer = detail::checkCompressedHeader(bytes) == Checksum::Crc32c ? 4 : 0;
+        std::string result;
+        std::size_t position = sizeof(detail::COMPRESSED_MAGIC) + 1;
+        while(position < bytes.size())
+        {
+            const auto method = static_cast<detail::BlockMethod>(bytes[position++]);
+            const std::uint64_t size = detail::readVarint(bytes, position);
+            const std::uint64_t stored = detail::readVarint(bytes, position);
+            if(size == 0)
+            {
+                return result;
+            }
+            if(size > detail::COMPRESSED_BLOCK || stored > size || stored + trailer > bytes.size() - position)
+            {
+                throw std::runtime_error("serialization: corrupt compressed block");
+            }
+            const std::string_view block = bytes.substr(position, stored);
+            if(trailer)
+            {
+                detail::checkCrc32c(block, bytes.data() + position + stored);
+            }
+            detail::decodeBlock(result, method, block, static_cast<std::size_t>(size));
+            position += static_cast<std::size_t>(stored) + trailer;
+        }
+        throw std::runtime_error("serialization: compressed data ends early");
+    }
+
+
+    /**
+     * The archive-namespace contains different Archive implementations, to store object in to different formats.
+     */
+    namespace archive
+    {
+        /**
+         * Base of every archive. Archives are only ever used as template parameters, so nothing is virtual and
+         * the whole encode path can be inlined. A Derived missing part of the interface fails to compile here.
+         */
+        template<typename Derived>
+        class IArchive
+        {
+        protected:
+            IArchive()
+            {
+                static_assert(detail::is_archive<Derived>::value,
+                    "An archive has to provide store, retrieve, saveToFile and loadFromFile.");
+            }
+        };
+
+        /**
+         * Holds any archive behind a runtime interface, for callers that pick the archive at runtime.
+         */
+        class AnyArchive
+        {
+        private:
+            struct Concept
+            {
+                virtual ~Concept() = default;
+                virtual bool saveToFile(const std::string& filepath) = 0;
+                virtual bool loadFromFile(const std::string& filepath) = 0;
+                virtual std::unique_ptr<Concept> clone() const = 0;
+                virtual const void* type() const = 0;
+            };
+
+            template<typename Archive>
+            struct Model : Concept
+            {
+                Archive archive;
+
+                explicit Model(Archive aArchive)
+                : archive(std::move(aArchive))
+                {
+                    // empty
+                }
+                bool saveToFile(const std::string& filepath) override
+                {
+                    return archive.saveToFile(filepath);
+                }
+                bool loadFromFile(const std::string& filepath) override
+                {
+                    return archive.loadFromFile(filepath);
+                }
+                std::unique_ptr<Concept> clone() const override
+                {
+                    return std::make_unique<Model>(archive);
+                }
+                const void* type() const override
+                {
+                    return &detail::archive_tag<Archive>;
+                }
+            };
+
+            std::unique_ptr<Concept> self;
+
+        public:
+            template<typename Archive, typename = std::enable_if_t<!std::is_same<std::decay_t<Archive>, AnyArchive>::value>>
+            AnyArchive(Archive archive)
+            : self(std::make_unique<Model<Archive>>(std::move(archive)))
+            {
+                static_assert(detail::is_archive<Archive>::value, "AnyArchive: Archive is not an archive.");
+            }
+            AnyArchive(const AnyArchive& other)
+            : self(other.self->clone())
+            {
+                // empty
+            }
+            AnyArchive(AnyArchive&&) = default;
+            AnyArchive& operator=(const AnyArchive& other)
+            {
+                self = other.self->clone();
+                return *this;
+            }
+            AnyArchive& operator=(AnyArchive&&) = default;
+
+            bool saveToFile(const std::string& filepath)
+            {
+                return self->saveToFile(filepath);
+            }
+            bool loadFromFile(const std::string& filepath)
+            {
+                return self->loadFromFile(filepath);
+            }
+            /**
+             * Returns the held archive, or nullptr if it is not an Archive.
+             */
+            template<typename Archive>
+            Archive* get()
+            {
+                return self->type() == &detail::archive_tag<Archive> ? &static_cast<Model<Archive>*>(self.get())->archive : nullptr;
+            }
+            template<typename Archive>
+            const Archive* get() const
+            {
+                return self->type() == &detail::archive_tag<Archive> ? &static_cast<const Model<Archive>*>(self.get())->archive : nullptr;
+            }
+        };
+
+        /**
+         * Stores properties as a JSON object. Values are written straight to JSON text and read back through a
+         * structural index, json::JSON is only used by getStorage and setStorage.
+         */
+        class JsonArchive : public IArchive<JsonArchive>
+        {
+        private:
+            /** The JSON object written so far. */
+            std::string storage = "{}";
+            /** The document properties are read from, built from storage on the first retrieve unless loaded. */
+            mutable std::shared_ptr<const detail::JsonDocument> document;
+            mutable detail::JsonValue object { 0, 0 };
+            mutable std::uint32_t hint = 0;
+            /** Nested archives share the object graph of the archive they are part of. */
+            const JsonArchive* owner = nullptr;
+            mutable std::shared_ptr<detail::ObjectGraph> graph;
+#if defined(SERIALIZATION_INSTRUMENTATION)
+            /** The end of the furthest value retrieved, as offset into the document. */
+            mutable std::size_t progress = 0;
+#endif
+
+            detail::JsonValue find(const char* name) const
+            {
+                if(!document)
+                {
+                    document = std::make_shared<const detail::JsonDocument>(storage);
+                    object = document->root();
+                    hint = 0;
+                }
+                return document->member(object, name, hint);
+            }
+            /**
+             * Reopens the object for another member called name.
+             */
+            void beginMember(const char* name)
+            {
+                if(document)
+                {
+                    storage = std::string(document->span(object));
+                    document.reset();
+                }
+                storage.pop_back();
+                if(storage.size() > 1)
+                {
+                    storage.push_back(',');
+                }
+                detail::writeJson(storage, std::string_view(name));
+                storage.push_back(':');
+            }
+            void endMember()
+            {
+                storage.push_back('}');
+            }
+            /**
+             * Returns an archive reading the object value.
+             */
+            JsonArchive nested(detail::JsonValue value) const
+            {
+                JsonArchive archive;
+                archive.object = value;
+                archive.document = document;
+                archive.owner = this;
+                return archive;
+            }
+            detail::ObjectGraph& objects() const
+            {
+                if(owner)
+                {
+                    return owner->objects();
+                }
+                if(!graph)
+                {
+                    graph = std::make_shared<detail::ObjectGraph>();
+                }
+                return *graph;
+            }
+
+        public:
+            std::string_view getText() const
+            {
+                return document ? document->span(object) : std::string_view(storage);
+            }
+            void setText(std::string text)
+            {
+                document = std::make_shared<const detail::JsonDocument>(std::move(text));
+                object = document->root();
+                hint = 0;
+                storage = "{}";
+            }
+            json::JSON getStorage() const
+            {
+                return json::JSON::Load(std::string(getText()));
+            }
+#if defined(SERIALIZATION_INSTRUMENTATION)
+            std::size_t bytesWritten() const
+            {
+                return storage.size();
+            }
+            /**
+             * Properties are looked up by name, so this is how far into the document retrieving has reached.
+             */
+            std::size_t bytesRead() const
+            {
+                return std::max(progress, static_cast<std::size_t>(object.begin));
+            }
+#endif
+            void setStorage(const json::JSON aStorage)
+            {
+                storage.clear();
+                detail::writeJsonTree(storage, aStorage);
+                document.reset();
+            }
+
+            /**
+             * Files are compressed block by block if compression is not None, and every block is checked on load
+             * if checksum is not None. loadFromFile has to be given the same compression and checksum as
+             * saveToFile, only the codec of the blocks is read from the file.
+             */
+            bool saveToFile(const std::string& filepath, Compression compression = Compression::None, Checksum checksum = Checksum::None)
+            {
+                return detail::writeFile(filepath, getText(), compression, checksum);
+            }
+            bool loadFromFile(const std::string& filepath, Compression compression = Compression::None, Checksum checksum = Checksum::None)
+            {
+                std::string text;
+                if(!detail::readFile(filepath, text, compression, checksum))
+                {
+                    return false;
+                }
+                setText(std::move(text));
+                return true;
+            }
+
+
+            template<typename T>
+            void store(const char* name, const T& value);
+
+            template<typename T>
+            T retrieve(const char* name) const;
+
+            /**
+             * JSON has no special encodings, so properties with a codec are stored as usual.
+             */
+            template<typename T, typename Codec>
+            void store(const char* name, const T& value, Codec)
+            {
+                store(name, value);
+            }
+            template<typename T, typename Codec>
+            T retrieve(const char* name, Codec) const
+            {
+                return retrieve<T>(name);
+            }
+
+            /**
+             * Stores the object held by archive as the member called name, so archives built on their own can
+             * be nested. retrieveArchive returns an archive reading that object.
+             */
+            void storeArchive(const char* name, const JsonArchive& archive)
+            {
+                beginMember(name);
+                storage.append(archive.getText());
+                endMember();
+            }
+            JsonArchive retrieveArchive(const char* name) const
+            {
+                JsonArchive archive = nested(find(name));
+                archive.owner = nullptr;
+                return archive;
+            }
+
+            /**
+             * Returns the values of member of every record in the Columns<T> called name.
+             */
+            template<typename T, auto member>
+            std::vector<detail::property_type<T, member>> retrieveColumn(const char* name) const
+            {
+                static_assert(detail::propertyIndex<T>(member) < std::tuple_size<decltype(T::PROPERTIES)>::value,
+                    "retrieveColumn: member is not part of the PROPERTIES");
+                constexpr auto property = std::get<detail::propertyIndex<T>(member)>(T::PROPERTIES);
+                return nested(find(name)).template retrieve<std::vector<detail::property_type<T, member>>>(property.name);
+            }
+
+            /**
+             * Properties are looked up by name, so nothing has to be skipped and the cursor is only a hint where
+             * the next lookup starts. Only values that can hold shared objects are read, as later references may
+             * point to the objects in them.
+             */
+            using Cursor = std::uint32_t;
+
+            template<typename T>
+            void skip(const char* name) const
+            {
+                if constexpr(detail::holdsShared<T>())
+                {
+                    retrieve<T>(name);
+                }
+            }
+            Cursor tell() const
+            {
+                return hint;
+            }
+            void seek(Cursor cursor) const
+            {
+                hint = cursor;
+            }
+            /**
+             * Forgets the shared objects read so far, so the archive can be read again. deserialize and the other
+             * readers call it first.
+             */
+            void rewind() const
+            {
+                hint = 0;
+                if(graph)
+                {
+                    graph->read.clear();
+                }
+#if defined(SERIALIZATION_INSTRUMENTATION)
+                progress = 0;
+#endif
+            }
+
+        private:
+            template<typename T>
+            IF_SERIALIZABLE(T, void) encode(const T& value);
+
+            template<typename T>
+            IF_CONTAINER(T, void) encode(const T& value);
+
+            template<typename T>
+            IF_PAIR(T, void) encode(const T& value);
+
+            template<typename T>
+            IF_SCALAR(T, void) encode(const T& value);
+
+            template<typename T>
+            IF_CACHED(T, void) encode(const T& value);
+
+            template<typename T>
+            IF_POINTER(T, void) encode(const T& value);
+
+            template<typename T>
+            IF_SHARED(T, void) encode(const T& value);
+
+            template<typename T>
+            IF_COLUMNS(T, void) encode(const T& value);
+
+            template<typename T>
+            IF_SERIALIZABLE(T, T) decode(detail::JsonValue value) const;
+
+            template<typename T>
+            IF_CONTAINER(T, T) decode(detail::JsonValue value) const;
+
+            template<typename T>
+            IF_PAIR(T, T) decode(detail::JsonValue value) const;
+
+            template<typename T>
+            IF_SCALAR(T, T) decode(detail::JsonValue value) const;
+
+            template<typename T>
+            IF_CACHED(T, T) decode(detail::JsonValue value) const;
+
+            template<typename T>
+            IF_POINTER(T, T) decode(detail::JsonValue value) const;
+
+            template<typename T>
+            IF_SHARED(T, T) decode(detail::JsonValue value) const;
+
+            template<typename T>
+            IF_COLUMNS(T, T) decode(detail::JsonValue value) const;
+
+            template<std::size_t index, typename T>
+            void encodeColumn(const std::vector<T>& records);
+
+            template<std::size_t index, typename T>
+            void decodeColumn(std::vector<T>& records) const;
+
+            template<typename T, std::size_t... indices>
+            void encodeColumns(const std::vector<T>& records, std::index_sequence<indices...>)
+            {
+                (encodeColumn<indices>(records), ...);
+            }
+
+            template<typename T, std::size_t... indices>
+            void decodeColumns(std::vector<T>& records, std::index_sequence<indices...>) const
+            {
+                (decodeColumn<indices>(records), ...);
+            }
+        };
+
+        template<typename T>
+        void JsonArchive::store(const char* name, const T& value)
+        {
+            beginMember(name);
+            encode(value);
+            endMember();
+        }
+
+        template<typename T>
+        T JsonArchive::retrieve(const char* name) const
+        {
+            const detail::JsonValue value = find(name);
+#if defined(SERIALIZATION_INSTRUMENTATION)
+            const std::string_view text = document->span(value);
+            progress = std::max(progress, static_cast<std::size_t>(text.data() + text.size() - document->text.data()));
+#endif
+            return decode<T>(value);
+        }
+
+        template<typename T>
+        IF_SERIALIZABLE(T, void) JsonArchive::encode(const T& value)
+        {
+            JsonArchive archive;
+            archive.owner = this;
+            detail::getData<0>(value, archive);
+            storage.append(archive.getText());
+        }
+
+        /**
+         * Containers are stored as arrays, std::pair as an array of two elements.
+         */
+        template<typename T>
+        IF_CONTAINER(T, void) JsonArchive::encode(const T& value)
+        {
+            storage.push_back('[');
+            bool first = true;
+            for(const auto& element : value)
+            {
+                if(!first)
+                {
+                    storage.push_back(',');
+                }
+                first = false;
+                encode(element);
+            }
+            storage.push_back(']');
+        }
+
+        template<typename T>
+        IF_PAIR(T, void) JsonArchive::encode(const T& value)
+        {
+            storage.push_back('[');
+            encode(value.first);
+            storage.push_back(',');
+            encode(value.second);
+            storage.push_back(']');
+        }
+
+        template<typename T>
+        IF_SCALAR(T, void) JsonArchive::encode(const T& value)
+        {
+            detail::writeJson(storage, value);
+        }
+
+        template<typename T>
+        IF_SERIALIZABLE(T, T) JsonArchive::decode(detail::JsonValue value) const
+        {
+            T result;
+            detail::setData<0>(result, nested(value));
+            return result;
+        }
+
+        template<typename T>
+        IF_CONTAINER(T, T) JsonArchive::decode(detail::JsonValue value) const
+        {
+            T result;
+            document->forEachElement(value, [&](detail::JsonValue element)
+            {
+                result.insert(result.end(), decode<typename T::value_type>(element));
+            });
+            return result;
+        }
+
+        template<typename T>
+        IF_PAIR(T, T) JsonArchive::decode(detail::JsonValue value) const
+        {
+            detail::JsonValue elements[2];
+            std::size_t count = 0;
+            document->forEachElement(value, [&](detail::JsonValue element)
+            {
+                if(count == 2)
+                {
+                    throw std::runtime_error("JsonArchive: expected a pair");
+                }
+                elements[count++] = element;
+            });
+            if(count != 2)
+            {
+                throw std::runtime_error("JsonArchive: expected a pair");
+            }
+            return T(decode<std::remove_const_t<typename T::first_type>>(elements[0]), decode<typename T::second_type>(elements[1]));
+        }
+
+        template<typename T>
+        IF_SCALAR(T, T) JsonArchive::decode(detail::JsonValue value) const
+        {
+            return detail::readJson<T>(*document, value);
+        }
+
+        /**
+         * Cached bytes are encoded with an object graph of their own, so objects that can hold shared objects
+         * are encoded every time, with the graph of this archive.
+         */
+        template<typename T>
+        IF_CACHED(T, void) JsonArchive::encode(const T& value)
+        {
+            if constexpr(detail::holdsShared<typename T::Type>())
+            {
+                encode(value.get());
+                return;
+            }
+            value.template appendEncoded<JsonArchive>(storage, [](const typename T::Type& object)
+            {
+                JsonArchive archive;
+                detail::getData<0>(object, archive);
+                return std::string(archive.getText());
+            });
+        }
+
+        template<typename T>
+        IF_CACHED(T, T) JsonArchive::decode(detail::JsonValue value) const
+        {
+            return T(decode<typename T::Type>(value));
+        }
+
+        /**
+         * Polymorphic objects are stored with their type id as "$type", null pointers as null.
+         */
+        template<typename T>
+        IF_POINTER(T, void) JsonArchive::encode(const T& value)
+        {
+            using Base = typename T::element_type;
+            if(!value)
+            {
+                storage += "null";
+                return;
+            }
+            const std::uint32_t id = detail::PolymorphicTypes<Base>::get().id(*value);
+            JsonArchive archive;
+            archive.owner = this;
+            archive.store("$type", id);
+            detail::PolymorphicTable<Base, JsonArchive>::at(id).store(*value, archive);
+            storage.append(archive.getText());
+        }
+
+        template<typename T>
+        IF_POINTER(T, T) JsonArchive::decode(detail::JsonValue value) const
+        {
+            using Base = typename T::element_type;
+            if(document->kind(value) == 'n')
+            {
+                return nullptr;
+            }
+            const JsonArchive archive = nested(value);
+            const std::uint32_t id = archive.retrieve<std::uint32_t>("$type");
+            T result = detail::PolymorphicTypes<Base>::get().create(id);
+            detail::PolymorphicTable<Base, JsonArchive>::at(id).retrieve(*result, archive);
+            return result;
+        }
+
+        /**
+         * Records stored column by column are an object with an array of values for every property.
+         */
+        template<typename T>
+        IF_COLUMNS(T, void) JsonArchive::encode(const T& value)
+        {
+            using Record = typename T::value_type;
+            JsonArchive archive;
+            archive.owner = this;
+            archive.encodeColumns(value, std::make_index_sequence<std::tuple_size<decltype(Record::PROPERTIES)>::value>());
+            storage.append(archive.getText());
+        }
+
+        template<typename T>
+        IF_COLUMNS(T, T) JsonArchive::decode(detail::JsonValue value) const
+        {
+            using Record = typename T::value_type;
+            T result;
+            nested(value).decodeColumns(result, std::make_index_sequence<std::tuple_size<decltype(Record::PROPERTIES)>::value>());
+            return result;
+        }
+
+        template<std::size_t index, typename T>
+        void JsonArchive::encodeColumn(const std::vector<T>& records)
+        {
+            constexpr auto property = std::get<index>(T::PROPERTIES);
+            beginMember(property.name);
+            storage.push_back('[');
+            for(std::size_t i = 0; i < records.size(); i++)
+            {
+                if(i)
+                {
+                    storage.push_back(',');
+                }
+                encode(records[i].*(property.member));
+            }
+            storage.push_back(']');
+            endMember();
+        }
+
+        /**
+         * The first column decides how many records there are, every other column has to have as many values.
+         */
+        template<std::size_t index, typename T>
+        void JsonArchive::decodeColumn(std::vector<T>& records) const
+        {
+            constexpr auto property = std::get<index>(T::PROPERTIES);
+            std::size_t count = 0;
+            document->forEachElement(find(property.name), [&](detail::JsonValue element)
+            {
+                if(index == 0)
+                {
+                    records.emplace_back();
+                }
+                else if(count == records.size())
+                {
+                    throw std::runtime_error("JsonArchive: columns differ in length");
+                }
+                records[count++].*(property.member) = decode<typename decltype(property)::Type>(element);
+            });
+            if(count != records.size())
+            {
+                throw std::runtime_error("JsonArchive: columns differ in length");
+            }
+        }
+
+        /**
+         * A shared object is stored with "$id" the first time, later only as {"$ref": id}.
+         */
+        template<typename T>
+        IF_SHARED(T, void) JsonArchive::encode(const T& value)
+        {
+            using Element = typename T::element_type;
+            if(!value)
+            {
+                storage += "null";
+                return;
+            }
+            const auto [id, added] = objects().written.insert(value.get());
+            JsonArchive archive;
+            archive.owner = this;
+            if(!added)
+            {
+                archive.store("$ref", id);
+            }
+            else if constexpr(std::is_polymorphic<Element>::value)
+            {
+                const std::uint32_t type = detail::PolymorphicTypes<Element>::get().id(*value);
+                archive.store("$id", id);
+                archive.store("$type", type);
+                detail::PolymorphicTable<Element, JsonArchive>::at(type).store(*value, archive);
+            }
+            else
+            {
+                archive.store("$id", id);
+                detail::getData<0>(*value, archive);
+            }
+            storage.append(archive.getText());
+        }
+
+        template<typename T>
+        IF_SHARED(T, T) JsonArchive::decode(detail::JsonValue value) const
+        {
+            using Element = typename T::element_type;
+            if(document->kind(value) == 'n')
+            {
+                return nullptr;
+            }
+            const JsonArchive archive = nested(value);
+            if(document->firstKey(value) == "$ref")
+            {
+                return objects().template find<Element>(archive.retrieve<std::uint64_t>("$ref"));
+            }
+            const std::uint64_t id = archive.retrieve<std::uint64_t>("$id");
+            std::uint32_t type = 0;
+            if constexpr(std::is_polymorphic<Element>::value)
+            {
+                type = archive.retrieve<std::uint32_t>("$type");
+            }
+            const T result = detail::createShared<Element>(type);
+            objects().add(id, result, document->text.size());
+            if constexpr(std::is_polymorphic<Element>::value)
+            {
+                detail::PolymorphicTable<Element, JsonArchive>::at(type).retrieve(*result, archive);
+            }
+            else
+            {
+                detail::setData<0>(*result, archive);
+            }
+            return result;
+        }
+
+        /**
+         * Stores properties as a compact little-endian byte sequence in declaration order. Property names are
+         * not stored, so an archive can only be read back by the same PROPERTIES layout it was written with, or by
+         * one that lacks properties at the end of nested objects.
+         */
+        class BinaryArchive : public IArchive<BinaryArchive>
+        {
+        private:
+            /** Flags of the batch header. */
+            static constexpr char BATCH_CHUNK_INDEX = 0x01;
+            static constexpr char BATCH_STRING_TABLE = 0x02;
+
+            /**
+             * Bools of an object are packed eight to a byte. This is the byte currently packed into and how many
+             * of its bits are in use.
+             */
+            struct BitCursor
+            {
+                std::size_t offset = 0;
+                unsigned used = 8;
+            };
+
+            std::string storage;
+            /** If set, the archive reads from these external bytes instead of storage. */
+            std::string_view borrowed;
+            mutable std::size_t position = 0;
+            BitCursor writeBits;
+            mutable BitCursor readBits;
+            mutable std::shared_ptr<detail::ObjectGraph> graph;
+            /** Only set while a batch is stored or retrieved. */
+            mutable std::shared_ptr<detail::StringTable> strings;
+
+            std::string_view bytes() const
+            {
+                return borrowed.data() ? borrowed : std::string_view(storage);
+            }
+            detail::ObjectGraph& objects() const
+            {
+                if(!graph)
+                {
+                    graph = std::make_shared<detail::ObjectGraph>();
+                }
+                return *graph;
+            }
+            const char* read(std::size_t size) const
+            {
+                const std::string_view data = bytes();
+                if(size > data.size() - position)
+                {
+                    throw std::out_of_range("BinaryArchive: read past the end of the archive");
+                }
+                const char* result = data.data() + position;
+                position += size;
+                return result;
+            }
+            std::uint64_t readVarint() const
+            {
+                std::uint64_t value = 0;
+                for(int shift = 0; shift < 64; shift += 7)
+                {
+                    const auto byte = static_cast<unsigned char>(*read(1));
+                    value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+                    if(!(byte & 0x80))
+                    {
+                        return value;
+                    }
+                }
+                throw std::runtime_error("BinaryArchive: malformed varint");
+            }
+            /**
+             * Inside a batch, strings are stored as 2 * length + 1 followed by their bytes, or as 2 * index if
+             * they are in the string table. Outside of one, as their length followed by their bytes.
+             */
+            void writeString(std::string_view value)
+            {
+                if(!strings)
+                {
+                    detail::writeVarint(storage, value.size());
+                    storage += value;
+                    return;
+                }
+                if(detail::StringTable::keeps(value.size()))
+                {
+                    const auto [entry, added] = strings->written.emplace(value, strings->written.size());
+                    if(!added)
+                    {
+                        detail::writeVarint(storage, entry->second * 2);
+                        return;
+                    }
+                }
+                detail::writeVarint(storage, value.size() * 2 + 1);
+                storage += value;
+            }
+            std::string_view readString() const
+            {
+                if(!strings)
+                {
+                    const std::uint64_t size = readVarint();
+                    return std::string_view(read(size), size);
+                }
+                const std::uint64_t tag = readVarint();
+                if(!(tag & 1))
+                {
+                    if(tag / 2 >= strings->read.size())
+                    {
+                        throw std::runtime_error("BinaryArchive: reference to string " + std::to_string(tag / 2) + ", which was not read");
+                    }
+                    return strings->read[tag / 2];
+                }
+                const std::string_view value(read(tag / 2), tag / 2);
+                if(detail::StringTable::keeps(value.size()))
+                {
+                    strings->read.push_back(value);
+                }
+                return value;
+            }
+            void writeBool(bool value)
+            {
+                if(writeBits.used == 8)
+                {
+                    writeBits = BitCursor { storage.size(), 0 };
+                    storage.push_back('\0');
+                }
+                if(value)
+                {
+                    storage[writeBits.offset] |= static_cast<char>(1 << writeBits.used);
+                }
+                writeBits.used++;
+            }
+            bool readBool() const
+            {
+                if(readBits.used == 8)
+                {
+                    readBits = BitCursor { position, 0 };
+                    read(1);
+                }
+                return (bytes()[readBits.offset] >> readBits.used++) & 1;
+            }
+            /**
+             * Objects and containers are stored with their length in front, so they can be skipped in one step,
+             * and pack their bools into their own bytes. The scope is where the value ends, or where its length
+             * has to be written, together with the bits of the enclosing value.
+             */
+            struct Scope
+            {
+                std::size_t offset;
+                BitCursor bits;
+            };
+            Scope beginScope()
+            {
+                const Scope scope { storage.size(), writeBits };
+                storage.push_back('\0');
+                writeBits = BitCursor();
+                return scope;
+            }
+            void endScope(const Scope& scope)
+            {
+                const std::size_t length = storage.size() - scope.offset - 1;
+                if(length < 0x80)
+                {
+                    storage[scope.offset] = static_cast<char>(length);
+                }
+                else
+                {
+                    std::string prefix;
+                    detail::writeVarint(prefix, length);
+                    storage.replace(scope.offset, 1, prefix);
+                }
+                writeBits = scope.bits;
+            }
+            Scope enterScope() const
+            {
+                const std::uint64_t length = readVarint();
+                if(length > bytes().size() - position)
+                {
+                    throw std::out_of_range("BinaryArchive: read past the end of the archive");
+                }
+                const Scope scope { position + static_cast<std::size_t>(length), readBits };
+                readBits = BitCursor();
+                return scope;
+            }
+            /**
+             * Continues after the value, which skips properties appended to it by newer versions of a type.
+             */
+            void leaveScope(const Scope& scope) const
+            {
+                if(position > scope.offset)
+                {
+                    throw std::runtime_error("BinaryArchive: value is longer than its stored length");
+                }
+                position = scope.offset;
+                readBits = scope.bits;
+            }
+            void skipScope() const
+            {
+                read(readVarint());
+            }
+            /**
+             * Objects whose memory is their record are copied in one step, which stores the same bytes.
+             */
+            template<typename T>
+            void storeObject(const T& object)
+            {
+                const Scope scope = beginScope();
+                if(detail::isPackedRecord<T>())
+                {
+                    storage.append(reinterpret_cast<const char*>(&object), sizeof(T));
+                }
+                else
+                {
+                    detail::getData<0>(object, *this);
+                }
+                endScope(scope);
+            }
+            template<typename T>
+            void retrieveObject(T& object) const
+            {
+                const Scope scope = enterScope();
+                if(detail::isPackedRecord<T>() && scope.offset - position >= sizeof(T))
+                {
+                    std::memcpy(static_cast<void*>(&object), read(sizeof(T)), sizeof(T));
+                }
+                else
+                {
+                    detail::setData<0>(object, *this);
+                }
+                leaveScope(scope);
+            }
+            /**
+             * Records of a container of fixed records are stored back to back, behind their common size instead
+             * of a length each. A vector of packed records is copied in one step.
+             */
+            template<typename T>
+            void storeRecords(const T& container)
+            {
+                using Record = typename T::value_type;
+                detail::writeVarint(storage, detail::record_size<Record>);
+                if constexpr(std::is_same<T, std::vector<Record>>::value)
+                {
+                    if(detail::isPackedRecord<Record>())
+                    {
+                        storage.append(reinterpret_cast<const char*>(container.data()), container.size() * sizeof(Record));
+                        return;
+                    }
+                }
+                for(const auto& record : container)
+                {
+                    detail::getData<0>(record, *this);
+                }
+            }
+            template<typename T>
+            void retrieveRecords(T& container, std::uint64_t count, std::size_t end) const
+            {
+                using Record = typename T::value_type;
+                const std::uint64_t size = readVarint();
+                if(size < detail::record_size<Record> || (count && size > (end - position) / count))
+                {
+                    throw std::runtime_error("BinaryArchive: records do not fit their container");
+                }
+                if constexpr(std::is_same<T, std::vector<Record>>::value)
+                {
+                    if(detail::isPackedRecord<Record>() && size == sizeof(Record))
+                    {
+                        container.resize(static_cast<std::size_t>(count));
+                        std::memcpy(static_cast<void*>(container.data()), read(container.size() * sizeof(Record)), container.size() * sizeof(Record));
+                        return;
+                    }
+                }
+                detail::reserve(container, count, end - position);
+                for(std::uint64_t i = 0; i < count; i++)
+                {
+                    const std::size_t next = position + static_cast<std::size_t>(size);
+                    Record record;
+                    detail::setData<0>(record, *this);
+                    // records of a newer version of the type are longer
+                    position = next;
+                    container.insert(container.end(), std::move(record));
+                }
+            }
+
+        public:
+            /**
+             * Returns an archive that reads from bytes without copying them. The bytes have to outlive the archive.
+             */
+            static BinaryArchive view(std::string_view bytes)
+            {
+                BinaryArchive archive;
+                archive.borrowed = bytes;
+                return archive;
+            }
+
+            std::string getStorage() const
+            {
+                return std::string(bytes());
+            }
+            void setStorage(const std::string& aStorage)
+            {
+                storage = aStorage;
+                borrowed = std::string_view();
+                position = 0;
+            }
+#if defined(SERIALIZATION_INSTRUMENTATION)
+            std::size_t bytesWritten() const
+            {
+                return storage.size();
+            }
+            std::size_t bytesRead() const
+            {
+                return position;
+            }
+#endif
+
+            /**
+             * Files are compressed block by block if compression is not None, and every block is checked on load
+             * if checksum is not None. loadFromFile has to be given the same compression and checksum as
+             * saveToFile, only the codec of the blocks is read from the file.
+             */
+            bool saveToFile(const std::string& filepath, Compression compression = Compression::None, Checksum checksum = Checksum::None)
+            {
+                return detail::writeFile(filepath, bytes(), compression, checksum);
+            }
+            bool loadFromFile(const std::string& filepath, Compression compression = Compression::None, Checksum checksum = Checksum::None)
+            {
+                std::string data;
+                if(!detail::readFile(filepath, data, compression, checksum))
+                {
+                    return false;
+                }
+                storage = std::move(data);
+                borrowed = std::string_view();
+                position = 0;
+                return true;
+            }
+
+            template<typename T>
+            void store(const char* name, const T& value);
+
+            template<typename T>
+            T retrieve(const char* name) const;
+
+            template<typename T>
+            void store(const char* name, const T& value, Delta);
+
+            template<typename T>
+            T retrieve(const char* name, Delta) const;
+
+            /**
+             * Stores the bytes of archive as one value, so archives built on their own can be nested.
+             * retrieveArchive returns a view of them, which borrows the bytes of this archive.
+             */
+            void storeArchive(const char*, const BinaryArchive& archive)
+            {
+                const Scope scope = beginScope();
+                storage.append(archive.bytes());
+                endScope(scope);
+            }
+            BinaryArchive retrieveArchive(const char*) const
+            {
+                const Scope scope = enterScope();
+                const BinaryArchive archive = view(bytes().substr(position, scope.offset - position));
+                leaveScope(scope);
+                return archive;
+            }
+
+            /**
+             * Returns the values of member of every record in the Columns<T> stored next, skipping the other columns.
+             */
+            template<typename T, auto member>
+            std::vector<detail::property_type<T, member>> retrieveColumn(const char*) const
+            {
+                using Type = detail::property_type<T, member>;
+                constexpr std::size_t index = detail::propertyIndex<T>(member);
+                static_assert(index < std::tuple_size<decltype(T::PROPERTIES)>::value, "retrieveColumn: member is not part of the PROPERTIES");
+                const Scope scope = enterScope();
+                const std::uint64_t count = readRecordCount(scope);
+                for(std::size_t i = 0; i < index; i++)
+                {
+                    skipScope();
+                }
+                std::vector<Type> result;
+                result.reserve(static_cast<std::size_t>(count));
+                readColumn<index, T>(count, [&](auto&& value)
+                {
+                    result.push_back(std::move(value));
+                });
+                leaveScope(scope);
+                return result;
+            }
+
+            /**
+             * Where retrieving continues, including the partially read byte of packed bools.
+             */
+            struct Cursor
+            {
+                std::size_t position = 0;
+                BitCursor bits;
+            };
+
+            template<typename T>
+            void skip(const char* name) const;
+
+            Cursor tell() const
+            {
+                return Cursor { position, readBits };
+            }
+            void seek(Cursor cursor) const
+            {
+                position = cursor.position;
+                readBits = cursor.bits;
+            }
+            /**
+             * Reads from the start again, and forgets the shared objects read so far. deserialize and the other
+             * readers call it first, so an archive can be read any number of times.
+             */
+            void rewind() const
+            {
+                position = 0;
+                readBits = BitCursor();
+                if(graph)
+                {
+                    graph->read.clear();
+                }
+                strings.reset();
+            }
+
+            template<typename T>
+            void storeBatch(const std::vector<T>& objects, std::size_t chunkSize);
+
+            template<typename T>
+            void retrieveBatch(std::vector<T>& objects, unsigned threads) const;
+
+        private:
+            template<typename T>
+            void storeChunks(const std::vector<T>& objects, std::size_t chunkSize);
+
+        private:
+            template<typename T>
+            IF_SERIALIZABLE(T, void) encode(const T& value);
+
+            template<typename T>
+            IF_CONTAINER(T, void) encode(const T& value);
+
+            template<typename T>
+            IF_PAIR(T, void) encode(const T& value);
+
+            template<typename T>
+            IF_SCALAR(T, void) encode(const T& value);
+
+            template<typename T>
+            IF_CACHED(T, void) encode(const T& value);
+
+            template<typename T>
+            IF_POINTER(T, void) encode(const T& value);
+
+            template<typename T>
+            IF_SHARED(T, void) encode(const T& value);
+
+            template<typename T>
+            IF_COLUMNS(T, void) encode(const T& value);
+
+            void encode(bool value);
+
+            void encode(const std::string& value);
+
+            template<typename T>
+            IF_SERIALIZABLE(T, T) decode() const;
+
+            template<typename T>
+            IF_CONTAINER(T, T) decode() const;
+
+            template<typename T>
+            IF_PAIR(T, T) decode() const;
+
+            template<typename T>
+            IF_SCALAR(T, T) decode() const;
+
+            template<typename T>
+            IF_CACHED(T, T) decode() const;
+
+            template<typename T>
+            IF_POINTER(T, T) decode() const;
+
+            template<typename T>
+            IF_SHARED(T, T) decode() const;
+
+            template<typename T>
+            IF_COLUMNS(T, T) decode() const;
+
+            template<typename T>
+            IF_SERIALIZABLE(T, void) pass() const;
+
+            template<typename T>
+            IF_CONTAINER(T, void) pass() const;
+
+            template<typename T>
+            IF_PAIR(T, void) pass() const;
+
+            template<typename T>
+            IF_SCALAR(T, void) pass() const;
+
+            template<typename T>
+            IF_CACHED(T, void) pass() const;
+
+            template<typename T>
+            IF_POINTER(T, void) pass() const;
+
+            template<typename T>
+            IF_SHARED(T, void) pass() const;
+
+            template<typename T>
+            IF_COLUMNS(T, void) pass() const;
+
+            template<std::size_t index, typename T>
+            void encodeColumn(const std::vector<T>& records);
+
+            template<std::size_t index, typename T>
+            void decodeColumn(std::vector<T>& records) const;
+
+            template<std::size_t index, typename T, typename Visit>
+            void readColumn(std::uint64_t count, Visit&& visit) const;
+
+            template<typename T, std::size_t... indices>
+            void encodeColumns(const std::vector<T>& records, std::index_sequence<indices...>)
+            {
+                (encodeColumn<indices>(records), ...);
+            }
+
+            template<typename T, std::size_t... indices>
+            void decodeColumns(std::vector<T>& records, std::index_sequence<indices...>) const
+            {
+                (decodeColumn<indices>(records), ...);
+            }
+
+            /**
+             * Every record takes at least a 64th of a byte of the scope, a bit for bools or less with the Delta
+             * codec, which bounds how many are allocated up front.
+             */
+            std::uint64_t readRecordCount(const Scope& scope) const
+            {
+                const std::uint64_t count = readVarint();
+                if(count / 64 > scope.offset - position)
+                {
+                    throw std::runtime_error("BinaryArchive: more records than the columns can hold");
+                }
+                return count;
+            }
+
+            template<typename Iterator, typename Get>
+            void writeDeltas(Iterator value, std::uint64_t count, Get&& get);
+
+            template<typename Visit>
+            void readDeltas(std::uint64_t count, Visit&& visit) const;
+        };
+
+        template<typename T>
+        void BinaryArchive::store(const char*, const T& value)
+        {
+            encode(value);
+        }
+
+        template<typename T>
+        T BinaryArchive::retrieve(const char*) const
+        {
+            return decode<T>();
+        }
+
+        template<typename T>
+        void BinaryArchive::skip(const char*) const
+        {
+            pass<T>();
+        }
+
+        template<typename T>
+        IF_SERIALIZABLE(T, void) BinaryArchive::encode(const T& value)
+        {
+            storeObject(value);
+        }
+
+        /**
+         * Containers are stored as a scope holding their element count followed by the elements.
+         */
+        template<typename T>
+        IF_CONTAINER(T, void) BinaryArchive::encode(const T& value)
+        {
+            const Scope scope = beginScope();
+            detail::writeVarint(storage, static_cast<std::uint64_t>(std::distance(value.begin(), value.end())));
+            if constexpr(detail::is_fixed_record<typename T::value_type>::value)
+            {
+                storeRecords(value);
+            }
+            else
+            {
+                for(const auto& element : value)
+                {
+                    encode(element);
+                }
+            }
+            endScope(scope);
+        }
+
+        template<typename T>
+        IF_PAIR(T, void) BinaryArchive::encode(const T& value)
+        {
+            encode(value.first);
+            encode(value.second);
+        }
+
+        template<typename T>
+        IF_SCALAR(T, void) BinaryArchive::encode(const T& value)
+        {
+            static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value, "BinaryArchive can not store this type.");
+            detail::writeLittleEndian(storage, value);
+        }
+
+        /**
+         * A cached object is stored like any other object, from bytes encoded on their own. Inside a batch its
+         * strings refer to the string table, and shared objects in it refer to the object graph of this archive,
+         * so then it is encoded again.
+         */
+        template<typename T>
+        IF_CACHED(T, void) BinaryArchive::encode(const T& value)
+        {
+            if(strings || detail::holdsShared<typename T::Type>())
+            {
+                storeObject(value.get());
+                return;
+            }
+            const Scope scope = beginScope();
+            value.template appendEncoded<BinaryArchive>(storage, [](const typename T::Type& object)
+            {
+                BinaryArchive archive;
+                detail::getData<0>(object, archive);
+                return std::move(archive.storage);
+            });
+            endScope(scope);
+        }
+
+        inline void BinaryArchive::encode(bool value)
+        {
+            writeBool(value);
+        }
+
+        inline void BinaryArchive::encode(const std::string& value)
+        {
+            writeString(value);
+        }
+
+        template<typename T>
+        IF_SERIALIZABLE(T, T) BinaryArchive::decode() const
+        {
+            T result;
+            retrieveObject(result);
+            return result;
+        }
+
+        template<typename T>
+        IF_CONTAINER(T, T) BinaryArchive::decode() const
+        {
+            T result;
+            const Scope scope = enterScope();
+            const std::uint64_t count = readVarint();
+            if constexpr(detail::is_fixed_record<typename T::value_type>::value)
+            {
+                retrieveRecords(result, count, scope.offset);
+            }
+            else
+            {
+                detail::reserve(result, count, scope.offset - position);
+                for(std::uint64_t i = 0; i < count; i++)
+                {
+                    result.insert(result.end(), decode<typename T::value_type>());
+                }
+            }
+            leaveScope(scope);
+            return result;
+        }
+
+        template<typename T>
+        IF_PAIR(T, T) BinaryArchive::decode() const
+        {
+            auto first = decode<std::remove_const_t<typename T::first_type>>();
+            auto second = decode<typename T::second_type>();
+            return T(std::move(first), std::move(second));
+        }
+
+        template<typename T>
+        IF_SCALAR(T, T) BinaryArchive::decode() const
+        {
+            if constexpr(std::is_same<T, bool>::value)
+            {
+                return readBool();
+            }
+            else if constexpr(std::is_same<T, std::string>::value)
+            {
+                return std::string(readString());
+            }
+            else
+            {
+                static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value, "BinaryArchive can not retrieve this type.");
+                return detail::decodeLittleEndian<T>(read(sizeof(T)));
+            }
+        }
+
+        template<typename T>
+        IF_CACHED(T, T) BinaryArchive::decode() const
+        {
+            return T(decode<typename T::Type>());
+        }
+
+        /**
+         * Polymorphic objects are stored as their type id followed by the object, null pointers as the id 0.
+         */
+        template<typename T>
+        IF_POINTER(T, void) BinaryArchive::encode(const T& value)
+        {
+            using Base = typename T::element_type;
+            if(!value)
+            {
+                detail::writeVarint(storage, 0);
+                return;
+            }
+            const std::uint32_t id = detail::PolymorphicTypes<Base>::get().id(*value);
+            detail::writeVarint(storage, id);
+            const Scope scope = beginScope();
+            detail::PolymorphicTable<Base, BinaryArchive>::at(id).store(*value, *this);
+            endScope(scope);
+        }
+
+        template<typename T>
+        IF_POINTER(T, T) BinaryArchive::decode() const
+        {
+            using Base = typename T::element_type;
+            const std::uint64_t id = readVarint();
+            if(!id)
+            {
+                return nullptr;
+            }
+            T result = detail::PolymorphicTypes<Base>::get().create(id);
+            const Scope scope = enterScope();
+            detail::PolymorphicTable<Base, BinaryArchive>::at(static_cast<std::uint32_t>(id)).retrieve(*result, *this);
+            leaveScope(scope);
+            return result;
+        }
+
+        /**
+         * A shared object is stored as 2 * id + 1 followed by the object the first time, later as 2 * id.
+         */
+        template<typename T>
+        IF_SHARED(T, void) BinaryArchive::encode(const T& value)
+        {
+            using Element = typename T::element_type;
+            if(!value)
+            {
+                detail::writeVarint(storage, 0);
+                return;
+            }
+            const auto [id, added] = objects().written.insert(value.get());
+            detail::writeVarint(storage, id * 2 + (added ? 1 : 0));
+            if(!added)
+            {
+                return;
+            }
+            if constexpr(std::is_polymorphic<Element>::value)
+            {
+                const std::uint32_t type = detail::PolymorphicTypes<Element>::get().id(*value);
+                detail::writeVarint(storage, type);
+                const Scope scope = beginScope();
+                detail::PolymorphicTable<Element, BinaryArchive>::at(type).store(*value, *this);
+                endScope(scope);
+            }
+            else
+            {
+                storeObject(*value);
+            }
+        }
+
+        template<typename T>
+        IF_SHARED(T, T) BinaryArchive::decode() const
+        {
+            using Element = typename T::element_type;
+            const std::uint64_t tag = readVarint();
+            if(!tag)
+            {
+                return nullptr;
+            }
+            if(!(tag & 1))
+            {
+                return objects().template find<Element>(tag / 2);
+            }
+            std::uint32_t type = 0;
+            if constexpr(std::is_polymorphic<Element>::value)
+            {
+                type = static_cast<std::uint32_t>(readVarint());
+            }
+            const T result = detail::createShared<Element>(type);
+            objects().add(tag / 2, result, bytes().size());
+            if constexpr(std::is_polymorphic<Element>::value)
+            {
+                const Scope scope = enterScope();
+                detail::PolymorphicTable<Element, BinaryArchive>::at(type).retrieve(*result, *this);
+                leaveScope(scope);
+            }
+            else
+            {
+                retrieveObject(*result);
+            }
+            return result;
+        }
+
+        /**
+         * A container stored with the Delta codec is a scope holding its element count and the coded elements.
+         * Other values are stored as usual.
+         */
+        template<typename T>
+        void BinaryArchive::store(const char*, const T& value, Delta)
+        {
+            if constexpr(detail::is_integer_sequence<T>::value)
+            {
+                const Scope scope = beginScope();
+                const auto count = static_cast<std::uint64_t>(std::distance(value.begin(), value.end()));
+                detail::writeVarint(storage, count);
+                writeDeltas(value.begin(), count, [](const auto& element)
+                {
+                    return element;
+                });
+                endScope(scope);
+            }
+            else
+            {
+                encode(value);
+            }
+        }
+
+        template<typename T>
+        T BinaryArchive::retrieve(const char*, Delta) const
+        {
+            if constexpr(detail::is_integer_sequence<T>::value)
+            {
+                T result;
+                const Scope scope = enterScope();
+                const std::uint64_t count = readVarint();
+                // a block of 128 equal differences takes two bytes
+                detail::reserve(result, count, (scope.offset - position) * 64 + 1);
+                readDeltas(count, [&](std::uint64_t element)
+                {
+                    result.insert(result.end(), static_cast<typename T::value_type>(element));
+                });
+                leaveScope(scope);
+                return result;
+            }
+            else
+            {
+                return decode<T>();
+            }
+        }
+
+        template<typename Iterator, typename Get>
+        void BinaryArchive::writeDeltas(Iterator value, std::uint64_t count, Get&& get)
+        {
+            if(count == 0)
+            {
+                return;
+            }
+            // signed values are extended, so differences across zero stay small
+            auto next = [&]()
+            {
+                const auto element = get(*value);
+                ++value;
+                return static_cast<std::uint64_t>(static_cast<std::conditional_t<std::is_signed<decltype(element)>::value, std::int64_t, std::uint64_t>>(element));
+            };
+            std::uint64_t previous = next();
+            detail::writeVarint(storage, detail::zigzag(previous));
+            std::uint64_t deltas[detail::DELTA_BLOCK];
+            for(std::uint64_t done = 1; done < count;)
+            {
+                const auto size = static_cast<std::size_t>(std::min<std::uint64_t>(detail::DELTA_BLOCK, count - done));
+                for(std::size_t i = 0; i < size; i++)
+                {
+                    const std::uint64_t current = next();
+                    deltas[i] = current - previous;
+                    previous = current;
+                }
+                detail::packDeltas(storage, deltas, size);
+                done += size;
+            }
+        }
+
+        template<typename Visit>
+        void BinaryArchive::readDeltas(std::uint64_t count, Visit&& visit) const
+        {
+            if(count == 0)
+            {
+                return;
+            }
+            std::uint64_t previous = detail::unzigzag(readVarint());
+            visit(previous);
+            std::uint64_t values[detail::DELTA_BLOCK];
+            for(std::uint64_t done = 1; done < count;)
+            {
+                const auto size = static_cast<std::size_t>(std::min<std::uint64_t>(detail::DELTA_BLOCK, count - done));
+                const std::uint64_t base = detail::unzigzag(readVarint());
+                const unsigned width = static_cast<unsigned char>(*read(1));
+                if(width > 57 && width != 64)
+                {
+                    throw std::runtime_error("BinaryArchive: invalid bit width in delta block");
+                }
+                detail::unpackBits(read((size * width + 7) / 8), size, width, values);
+                previous = detail::prefixSum(values, size, base, previous);
+                for(std::size_t i = 0; i < size; i++)
+                {
+                    visit(values[i]);
+                }
+                done += size;
+            }
+        }
+
+        /**
+         * Records stored column by column are a scope holding their count followed by one scope per property.
+         * Integers with the Delta codec are coded, other numbers and enums of a column are stored back to back,
+         * everything else as it is stored elsewhere.
+         */
+        template<typename T>
+        IF_COLUMNS(T, void) BinaryArchive::encode(const T& value)
+        {
+            using Record = typename T::value_type;
+            const Scope scope = beginScope();
+            detail::writeVarint(storage, value.size());
+            encodeColumns(value, std::make_index_sequence<std::tuple_size<decltype(Record::PROPERTIES)>::value>());
+            endScope(scope);
+        }
+
+        /**
+         * Columns appended by newer versions of the record type are skipped with the rest of the scope.
+         */
+        template<typename T>
+        IF_COLUMNS(T, T) BinaryArchive::decode() const
+        {
+            using Record = typename T::value_type;
+            T result;
+            const Scope scope = enterScope();
+            result.resize(static_cast<std::size_t>(readRecordCount(scope)));
+            decodeColumns(result, std::make_index_sequence<std::tuple_size<decltype(Record::PROPERTIES)>::value>());
+            leaveScope(scope);
+            return result;
+        }
+
+        template<std::size_t index, typename T>
+        void BinaryArchive::encodeColumn(const std::vector<T>& records)
+        {
+            constexpr auto property = std::get<index>(T::PROPERTIES);
+            using Type = typename decltype(property)::Type;
+            const Scope scope = beginScope();
+            if constexpr(std::is_same<typename decltype(property)::Codec, Delta>::value && std::is_integral<Type>::value && !std::is_same<Type, bool>::value)
+            {
+                writeDeltas(records.begin(), records.size(), [](const T& record)
+                {
+                    return record.*(property.member);
+                });
+            }
+            else if constexpr(detail::is_fixed_width<Type>::value)
+            {
+                const std::size_t begin = storage.size();
+                storage.resize(begin + records.size() * sizeof(Type));
+                char* output = &storage[begin];
+                for(const T& record : records)
+                {
+                    detail::encodeLittleEndian<Type>(output, record.*(property.member));
+                    output += sizeof(Type);
+                }
+            }
+            else
+            {
+                for(const T& record : records)
+                {
+                    encode(record.*(property.member));
+                }
+            }
+            endScope(scope);
+        }
+
+        template<std::size_t index, typename T>
+        void BinaryArchive::decodeColumn(std::vector<T>& records) const
+        {
+            constexpr auto property = std::get<index>(T::PROPERTIES);
+            std::size_t i = 0;
+            readColumn<index, T>(records.size(), [&](auto&& value)
+            {
+                records[i++].*(property.member) = std::move(value);
+            });
+        }
+
+        /**
+         * Reads the column of property index of count records and calls visit with every value.
+         */
+        template<std::size_t index, typename T, typename Visit>
+        void BinaryArchive::readColumn(std::uint64_t count, Visit&& visit) const
+        {
+            constexpr auto property = std::get<index>(T::PROPERTIES);
+            using Type = typename decltype(property)::Type;
+            const Scope scope = enterScope();
+            if constexpr(std::is_same<typename decltype(property)::Codec, Delta>::value && std::is_integral<Type>::value && !std::is_same<Type, bool>::value)
+            {
+                readDeltas(count, [&](std::uint64_t value)
+                {
+                    visit(static_cast<Type>(value));
+                });
+            }
+            else if constexpr(detail::is_fixed_width<Type>::value)
+            {
+                const char* data = read(static_cast<std::size_t>(count) * sizeof(Type));
+                for(std::uint64_t i = 0; i < count; i++)
+                {
+                    visit(detail::decodeLittleEndian<Type>(data + i * sizeof(Type)));
+                }
+            }
+            else
+            {
+                for(std::uint64_t i = 0; i < count; i++)
+                {
+                    visit(decode<Type>());
+                }
+            }
+            leaveScope(scope);
+        }
+
+        template<typename T>
+        IF_COLUMNS(T, void) BinaryArchive::pass() const
+        {
+            if constexpr(detail::holdsShared<T>())
+            {
+                decode<T>();
+            }
+            else
+            {
+                skipScope();
+            }
+        }
+
+        /**
+         * pass moves past a value the same way decode reads it, without constructing it. Values that can hold
+         * shared objects are decoded, as later references may point to the objects in them.
+         */
+        template<typename T>
+        IF_SERIALIZABLE(T, void) BinaryArchive::pass() const
+        {
+            if constexpr(detail::holdsShared<T>())
+            {
+                decode<T>();
+            }
+            else
+            {
+                skipScope();
+            }
+        }
+
+        template<typename T>
+        IF_CONTAINER(T, void) BinaryArchive::pass() const
+        {
+            if constexpr(detail::holdsShared<T>())
+            {
+                decode<T>();
+            }
+            else
+            {
+                skipScope();
+            }
+        }
+
+        template<typename T>
+        IF_CACHED(T, void) BinaryArchive::pass() const
+        {
+            if constexpr(detail::holdsShared<T>())
+            {
+                decode<T>();
+            }
+            else
+            {
+                skipScope();
+            }
+        }
+
+        template<typename T>
+        IF_SHARED(T, void) BinaryArchive::pass() const
+        {
+            decode<T>();
+        }
+
+        template<typename T>
+        IF_POINTER(T, void) BinaryArchive::pass() const
+        {
+            decode<T>();
+        }
+
+        template<typename T>
+        IF_PAIR(T, void) BinaryArchive::pass() const
+        {
+            pass<std::remove_const_t<typename T::first_type>>();
+            pass<typename T::second_type>();
+        }
+
+        template<typename T>
+        IF_SCALAR(T, void) BinaryArchive::pass() const
+        {
+            if constexpr(std::is_same<T, bool>::value)
+            {
+                readBool();
+            }
+            else if constexpr(std::is_same<T, std::string>::value)
+            {
+                readString();
+            }
+            else
+            {
+                static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value, "BinaryArchive can not skip this type.");
+                read(sizeof(T));
+            }
+        }
+
+        /**
+         * A batch starts with the record count and a flags byte. Indexed batches continue with the chunk size and
+         * one 64-bit offset per chunk, plus the end offset of the last chunk, relative to the first record.
+         * Strings of the records share a string table, which starts over with every chunk.
+         */
+        template<typename T>
+        void BinaryArchive::storeBatch(const std::vector<T>& objects, std::size_t chunkSize)
+        {
+            detail::writeVarint(storage, objects.size());
+            storage.push_back(static_cast<char>((chunkSize ? BATCH_CHUNK_INDEX : 0) | BATCH_STRING_TABLE));
+            strings = std::make_shared<detail::StringTable>();
+            try
+            {
+                storeChunks(objects, chunkSize);
+            }
+            catch(...)
+            {
+                strings.reset();
+                throw;
+            }
+            strings.reset();
+        }
+
+        template<typename T>
+        void BinaryArchive::storeChunks(const std::vector<T>& objects, std::size_t chunkSize)
+        {
+            if(!chunkSize)
+            {
+                for(const T& object : objects)
+                {
+                    storeObject(object);
+                }
+                return;
+            }
+            detail::writeVarint(storage, chunkSize);
+            const std::size_t chunks = (objects.size() + chunkSize - 1) / chunkSize;
+            const std::size_t index = storage.size();
+            storage.append((chunks + 1) * sizeof(std::uint64_t), '\0');
+            const std::size_t begin = storage.size();
+            for(std::size_t i = 0; i < objects.size(); i++)
+            {
+                if(i % chunkSize == 0)
+                {
+                    detail::encodeLittleEndian<std::uint64_t>(&storage[index + (i / chunkSize) * sizeof(std::uint64_t)], storage.size() - begin);
+                    // chunks are decoded on their own, so shared objects are only referred to inside a chunk
+                    if(graph)
+                    {
+                        graph->written.clear();
+                    }
+                    strings->clear();
+                }
+                storeObject(objects[i]);
+            }
+            detail::encodeLittleEndian<std::uint64_t>(&storage[index + chunks * sizeof(std::uint64_t)], storage.size() - begin);
+        }
+
+        template<typename T>
+        void BinaryArchive::retrieveBatch(std::vector<T>& objects, unsigned threads) const
+        {
+            const std::uint64_t count = readVarint();
+            const char flags = *read(1);
+            // every record takes at least a byte, so a larger count is corrupt and mustn't be allocated
+            if(count > bytes().size() - position)
+            {
+                throw std::runtime_error("BinaryArchive: corrupt batch record count");
+            }
+            objects.clear();
+            objects.resize(count);
+            if(!(flags & BATCH_CHUNK_INDEX))
+            {
+                if(flags & BATCH_STRING_TABLE)
+                {
+                    strings = std::make_shared<detail::StringTable>();
+                }
+                try
+                {
+                    for(T& object : objects)
+                    {
+                        retrieveObject(object);
+                    }
+                }
+                catch(...)
+                {
+                    strings.reset();
+                    throw;
+                }
+                strings.reset();
+                return;
+            }
+            const std::uint64_t chunkSize = readVarint();
+            if(!chunkSize)
+            {
+                throw std::runtime_error("BinaryArchive: invalid batch chunk size");
+            }
+            const std::size_t chunks = (count + chunkSize - 1) / chunkSize;
+            const char* index = read((chunks + 1) * sizeof(std::uint64_t));
+            const std::string_view records = bytes().substr(position);
+            std::vector<std::uint64_t> offsets(chunks + 1);
+            for(std::size_t chunk = 0; chunk <= chunks; chunk++)
+            {
+                offsets[chunk] = detail::decodeLittleEndian<std::uint64_t>(index + chunk * sizeof(std::uint64_t));
+                if(offsets[chunk] > records.size() || (chunk > 0 && offsets[chunk] < offsets[chunk - 1]))
+                {
+                    throw std::runtime_error("BinaryArchive: corrupt batch chunk index");
+                }
+            }
+
+            auto decodeChunk = [&](std::size_t chunk)
+            {
+                const BinaryArchive archive = BinaryArchive::view(records.substr(offsets[chunk], offsets[chunk + 1] - offsets[chunk]));
+                if(flags & BATCH_STRING_TABLE)
+                {
+                    archive.strings = std::make_shared<detail::StringTable>();
+                }
+                const std::size_t end = std::min<std::size_t>(count, (chunk + 1) * chunkSize);
+                for(std::size_t i = chunk * chunkSize; i < end; i++)
+                {
+                    archive.retrieveObject(objects[i]);
+                }
+            };
+
+            if(threads == 0)
+            {
+                threads = std::max(1u, std::thread::hardware_concurrency());
+            }
+            threads = static_cast<unsigned>(std::min<std::size_t>(threads, chunks));
+            if(threads <= 1)
+            {
+                for(std::size_t chunk = 0; chunk < chunks; chunk++)
+                {
+                    decodeChunk(chunk);
+                }
+            }
+            else
+            {
+                std::atomic<std::size_t> next { 0 };
+                std::exception_ptr error;
+                std::mutex errorMutex;
+                std::vector<std::thread> workers;
+                workers.reserve(threads);
+                for(unsigned i = 0; i < threads; i++)
+                {
+                    workers.emplace_back([&]()
+                    {
+                        for(std::size_t chunk = next++; chunk < chunks; chunk = next++)
+                        {
+                            try
+                            {
+                                decodeChunk(chunk);
+                            }
+                            catch(...)
+                            {
+                                std::lock_guard<std::mutex> lock(errorMutex);
+                                if(!error)
+                                {
+                                    error = std::current_exception();
+                                }
+                                next = chunks;
+                            }
+                        }
+                    });
+                }
+                for(std::thread& worker : workers)
+                {
+                    worker.join();
+                }
+                if(error)
+                {
+                    std::rethrow_exception(error);
+                }
+            }
+            position += offsets[chunks];
+        }
+    }
+
+    namespace detail
+    {
+        /**
+         * Appends record, stored in an IArchive of its own, to a record stream.
+         */
+        template<typename IArchive, typename T>
+        void appendRecord(std::string& output, const T& record, bool checksummed)
+        {
+            static_assert(std::is_same<IArchive, archive::BinaryArchive>::value || std::is_same<IArchive, archive::JsonArchive>::value,
+                "record streams can only be written with BinaryArchive or JsonArchive");
+            const IArchive archive = serialize<IArchive>(record);
+            auto append = [&](std::string_view bytes)
+            {
+                serialization::detail::writeVarint(output, bytes.size());
+                output.append(bytes);
+                if(checksummed)
+                {
+                    serialization::detail::appendCrc32c(output, bytes);
+                }
+            };
+            if constexpr(std::is_same<IArchive, archive::BinaryArchive>::value)
+            {
+                append(archive.getStorage());
+            }
+            else
+            {
+                append(archive.getText());
+            }
+        }
+
+        template<typename IArchive, typename T>
+        void decodeRecord(std::string_view bytes, T& record)
+        {
+            static_assert(std::is_same<IArchive, archive::BinaryArchive>::value || std::is_same<IArchive, archive::JsonArchive>::value,
+                "record streams can only be read with BinaryArchive or JsonArchive");
+            if constexpr(std::is_same<IArchive, archive::BinaryArchive>::value)
+            {
+                deserialize(IArchive::view(bytes), record);
+            }
+            else
+            {
+                IArchive archive;
+                archive.setText(std::string(bytes));
+                deserialize(archive, record);
+            }
+        }
+    }
+
+    /**
+     * Reads the records of a record stream one after the other, each into the same T. Only a window of the file is
+     * held in memory, so streams of any size can be read. Created by readStream.
+     */
+    template<typename IArchive, typename T>
+    class RecordStream
+    {
+    private:
+        detail::WindowReader reader;
+        bool checksummed;
+        T record;
+
+    public:
+        class iterator
+        {
+        private:
+            RecordStream* stream;
+
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = T*;
+            using reference = T&;
+
+            explicit iterator(RecordStream* aStream = nullptr)
+            : stream(aStream) {}
+
+            T& operator*() const
+            {
+                return stream->record;
+            }
+            T* operator->() const
+            {
+                return &stream->record;
+            }
+            iterator& operator++()
+            {
+                if(!stream->next())
+                {
+                    stream = nullptr;
+                }
+                return *this;
+            }
+            bool operator==(const iterator& other) const
+            {
+                return stream == other.stream;
+            }
+            bool operator!=(const iterator& other) const
+            {
+                return stream != other.stream;
+            }
+        };
+
+        RecordStream(const std::string& filepath, std::size_t window)
+        : reader(filepath, window)
+        {
+            checksummed = detail::readRecordHeader(reader, filepath);
+        }
+
+        /**
+         * Reads the next record into current, returns false at the end of the stream.
+         */
+        bool next()
+        {
+            std::string_view bytes;
+            switch(detail::readRecord(reader, checksummed, bytes))
+            {
+                case detail::RecordRead::End:
+                    return false;
+                case detail::RecordRead::Truncated:
+                    throw std::runtime_error("readStream: record stream ends early");
+                default:
+                    detail::decodeRecord<IArchive>(bytes, record);
+                    return true;
+            }
+        }
+        T& current()
+        {
+            return record;
+        }
+
+        iterator begin()
+        {
+            return iterator(next() ? this : nullptr);
+        }
+        iterator end()
+        {
+            return iterator();
+        }
+    };
+
+    /**
+     * Opens a record stream written by writeStream or ArchiveWriter, to be iterated once. Compressed streams are
+     * decompressed on the fly. window is about how many bytes of the file are read at once.
+     */
+    template<typename IArchive, typename T>
+    RecordStream<IArchive, T> readStream(const std::string& filepath, std::size_t window = detail::RECORD_WINDOW)
+    {
+        return RecordStream<IArchive, T>(filepath, window);
+    }
+
+    /**
+     * Writes every record of records, each stored in an IArchive of its own, as a record stream. Compression and
+     * checksum work as in saveToFile.
+     */
+    template<typename IArchive, typename Records>
+    bool writeStream(const std::string& filepath, const Records& records, Compression compression = Compression::None, Checksum checksum = Checksum::None)
+    {
+        std::ofstream file(filepath, std::ios::binary);
+        std::optional<detail::BlockWriter> blocks;
+        if(compression != Compression::None || checksum != Checksum::None)
+        {
+            blocks.emplace(file, compression, checksum);
+        }
+        std::string buffer;
+        detail::appendRecordHeader(buffer, Checksum::None);
+        auto flush = [&]()
+        {
+            if(blocks)
+            {
+                blocks->write(buffer);
+            }
+            else
+            {
+                file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            }
+            buffer.clear();
+        };
+        for(const auto& record : records)
+        {
+            detail::appendRecord<IArchive>(buffer, record, false);
+            if(buffer.size() >= detail::RECORD_WINDOW)
+            {
+                flush();
+            }
+        }
+        flush();
+        if(blocks)
+        {
+            blocks->finish();
+        }
+        return static_cast<bool>(file);
+    }
+
+    /**
+     * Appends records to a record stream, eg. an event journal, without rewriting what is already stored. Records
+     * are buffered until flushSize bytes are pending or, if flushInterval is not 0, an append comes flushInterval
+     * after the last flush, and on flush and destruction. Opening an existing stream continues it, with the
+     * checksum it was created with. A record cut off at its end, as left by a crash, is removed first.
+     */
+    template<typename IArchive, typename T>
+    class ArchiveWriter
+    {
+    private:
+        std::string filepath;
+        std::ofstream file;
+        std::string buffer;
+        /** The size of the file up to the last record that was completely flushed. */
+        std::uint64_t end = 0;
+        bool checksummed = false;
+        std::size_t flushSize;
+        std::chrono::steady_clock::duration flushInterval;
+        std::chrono::steady_clock::time_point flushed;
+
+        /**
+         * Reads the stream at filepath up to its last complete record and cuts off what follows it. Returns
+         * whether the stream existed.
+         */
+        bool resume()
+        {
+            std::uint64_t size = 0;
+            {
+                std::ifstream existing(filepath, std::ios::binary | std::ios::ate);
+                if(!existing || existing.tellg() <= 0)
+                {
+                    return false;
+                }
+                size = static_cast<std::uint64_t>(existing.tellg());
+            }
+            {
+                // closed before the file is truncated, which some systems don't allow for open files
+                detail::WindowReader reader(filepath, detail::RECORD_WINDOW);
+                if(reader.compressed())
+                {
+                    throw std::invalid_argument("ArchiveWriter: " + filepath + " is compressed and can't be appended to");
+                }
+                checksummed = detail::readRecordHeader(reader, filepath);
+                std::string_view record;
+                while(detail::readRecord(reader, checksummed, record) == detail::RecordRead::Record)
+                {
+                }
+                end = reader.tell();
+            }
+            if(end < size)
+            {
+                std::filesystem::resize_file(filepath, end);
+            }
+            return true;
+        }
+        /**
+         * Opens the file for appending again after a failed write, once the bytes that were written of the
+         * pending records are removed.
+         */
+        bool reopen()
+        {
+            std::error_code error;
+            if(std::filesystem::file_size(filepath, error) != end)
+            {
+                std::filesystem::resize_file(filepath, end, error);
+                if(error)
+                {
+                    return false;
+                }
+            }
+            file.clear();
+            file.open(filepath, std::ios::binary | std::ios::app);
+            return static_cast<bool>(file);
+        }
+
+    public:
+        explicit ArchiveWriter(const std::string& aFilepath, Checksum checksum = Checksum::None, std::size_t aFlushSize = detail::RECORD_WINDOW,
+            std::chrono::milliseconds aFlushInterval = std::chrono::milliseconds(0))
+        : filepath(aFilepath), flushSize(aFlushSize), flushInterval(aFlushInterval), flushed(std::chrono::steady_clock::now())
+        {
+            const bool resumed = resume();
+            file.open(filepath, std::ios::binary | std::ios::app);
+            if(!file)
+            {
+                throw std::runtime_error("ArchiveWriter: cannot open " + filepath);
+            }
+            if(!resumed)
+            {
+                checksummed = checksum == Checksum::Crc32c;
+                detail::appendRecordHeader(buffer, checksum);
+                if(!flush())
+                {
+                    throw std::runtime_error("ArchiveWriter: cannot write " + filepath);
+                }
+            }
+        }
+        ArchiveWriter(const ArchiveWriter&) = delete;
+        ArchiveWriter& operator=(const ArchiveWriter&) = delete;
+        ~ArchiveWriter()
+        {
+            flush();
+        }
+
+        /**
+         * Returns false if the record had to be flushed, and writing failed. It is still pending then.
+         */
+        bool append(const T& record)
+        {
+            detail::appendRecord<IArchive>(buffer, record, checksummed);
+            if(buffer.size() >= flushSize || (flushInterval.count() > 0 && std::chrono::steady_clock::now() - flushed >= flushInterval))
+            {
+                return flush();
+            }
+            return true;
+        }
+
+        /**
+         * Hands the pending records to the operating system. If that fails, whatever was written of them is
+         * removed again and they stay pending, so the next flush retries them.
+         */
+        bool flush()
+        {
+            if(!file.is_open() && !reopen())
+            {
+                return false;
+            }
+            file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            file.flush();
+            if(!file)
+            {
+                file.close();
+                std::error_code error;
+                std::filesystem::resize_file(filepath, end, error);
+                return false;
+            }
+            end += buffer.size();
+            buffer.clear();
+            flushed = std::chrono::steady_clock::now();
+            return true;
+        }
+    };
+
+    /**
+     * Registers Derived with the id it is stored with behind a std::unique_ptr<Base>, for every archive in
+     * Archives. Ids have to be the same wherever the archives are read, start at 1 and should be kept small, as
+     * they index a table. factory creates the object a stored Derived is read into.
+     */
+    template<typename Base, typename Derived, typename... Archives>
+    void registerType(std::uint32_t id, std::unique_ptr<Base> (*factory)() = nullptr)
+    {
+        static_assert(std::has_virtual_destructor<Base>::value, "registerType: Base needs a virtual destructor");
+        static_assert(std::is_base_of<Base, Derived>::value && detail::has_properties<Derived>::value,
+            "registerType: Derived has to be derived from Base and have the SERIALIZE-macro");
+        if(id == 0)
+        {
+            throw std::invalid_argument("registerType: the type id 0 stands for null pointers");
+        }
+        detail::PolymorphicTypes<Base>& types = detail::PolymorphicTypes<Base>::get();
+        types.ids[std::type_index(typeid(Derived))] = id;
+        types.factories.resize(std::max<std::size_t>(types.factories.size(), id + 1));
+        types.factories[id] = factory ? factory : []() -> std::unique_ptr<Base>
+        {
+            return std::make_unique<Derived>();
+        };
+        types.comparators.resize(types.factories.size());
+        types.comparators[id] = [](const Base& a, const Base& b)
+        {
+            return detail::equal(static_cast<const Derived&>(a), static_cast<const Derived&>(b));
+        };
+        if constexpr(sizeof...(Archives) == 0)
+        {
+            detail::PolymorphicTable<Base, archive::JsonArchive>::template add<Derived>(id);
+            detail::PolymorphicTable<Base, archive::BinaryArchive>::template add<Derived>(id);
+        }
+        else
+        {
+            (detail::PolymorphicTable<Base, Archives>::template add<Derived>(id), ...);
         }
     }
 }
@@ -0,0 +1,711 @@
+/**
+ * Round-trips every kind of value through every archive, and checks the file formats built on top of them.
+ *
+ * usage: serializationpp_tests [filter]
+ * Only tests whose name contains filter are run. Exits with 1 if any of them fails.
+ */
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "serialization++.h"
+
+using serialization::archive::BinaryArchive;
+using serialization::archive::JsonArchive;
+
+/** CHECKS */
+#define CHECK(condition) \
+    do \
+    { \
+        if(!(condition)) \
+        { \
+            throw std::runtime_error(std::string(__FILE__) + ":" + std::to_string(__LINE__) + ": " #condition); \
+        } \
+    } while(false)
+
+#define CHECK_THROWS(statement) \
+    do \
+    { \
+        bool thrown = false; \
+        try \
+        { \
+            statement; \
+        } \
+        catch(const std::exception&) \
+        { \
+            thrown = true; \
+        } \
+        CHECK(thrown && #statement); \
+    } while(false)
+
+/**
+ * A path in the temporary directory that is removed again when it goes out of scope.
+ */
+class TemporaryFile
+{
+private:
+    std::string path;
+public:
+    explicit TemporaryFile(const std::string& name)
+    : path((std::filesystem::temp_directory_path() / ("serializationpp_" + name)).string())
+    {
+        std::filesystem::remove(path);
+    }
+    ~TemporaryFile()
+    {
+        std::error_code error;
+        std::filesystem::remove(path, error);
+    }
+    const std::string& get() const
+    {
+        return path;
+    }
+};
+
+/** TYPES */
+namespace types
+{
+    enum class Color { Red, Green, Blue };
+
+    class Human
+    {
+    public:
+        std::string name;
+        int age = 0;
+
+        Human(const std::string& aName = "", int aAge = 0)
+        : name(aName), age(aAge) {}
+
+        SERIALIZE(
+            STORE(&Human::name, "name"),
+            STORE(&Human::age, "age")
+        );
+    };
+
+    class Parent : public Human
+    {
+    public:
+        Human child;
+        Color color = Color::Red;
+        bool married = false;
+        std::vector<int> ids;
+        std::map<std::string, double> scores;
+
+        SERIALIZE_BASE(Human,
+            STORE(&Parent::child, "child"),
+            STORE(&Parent::color, "color"),
+            STORE(&Parent::married, "married"),
+            STORE(&Parent::ids, "ids"),
+            STORE(&Parent::scores, "scores")
+        );
+
+        static Parent make()
+        {
+            Parent parent;
+            parent.name = "Steve \"Jobs\"\n";
+            parent.age = 56;
+            parent.child = Human("Mark", 32);
+            parent.color = Color::Blue;
+            parent.married = true;
+            parent.ids = { 1, -2, 3000000 };
+            parent.scores = { { "a", 0.5 }, { "b", -1e300 } };
+            return parent;
+        }
+        bool operator==(const Parent& other) const
+        {
+            return name == other.name && age == other.age && child.name == other.child.name && child.age == other.child.age
+                && color == other.color && married == other.married && ids == other.ids && scores == other.scores;
+        }
+    };
+
+    struct Tick
+    {
+        std::int64_t time = 0;
+        double price = 0;
+        std::uint8_t side = 0;
+
+        SERIALIZE(
+            STORE(&Tick::time, "time"),
+            STORE(&Tick::price, "price"),
+            STORE(&Tick::side, "side")
+        );
+
+        bool operator==(const Tick& other) const
+        {
+            return time == other.time && price == other.price && side == other.side;
+        }
+    };
+
+    struct Journal
+    {
+        std::vector<std::int64_t> timestamps;
+        std::vector<std::uint32_t> counts;
+        serialization::Columns<Tick> ticks;
+
+        SERIALIZE(
+            STORE_AS(&Journal::timestamps, "timestamps", serialization::Delta),
+            STORE_AS(&Journal::counts, "counts", serialization::Delta),
+            STORE(&Journal::ticks, "ticks")
+        );
+
+        static Journal make(std::size_t size)
+        {
+            Journal journal;
+            std::int64_t time = 1600000000000;
+            for(std::size_t i = 0; i < size; i++)
+            {
+                time += static_cast<std::int64_t>(i % 7 == 0 ? 1000 : i % 3);
+                journal.timestamps.push_back(i % 50 == 0 ? time - 5000 : time);
+                journal.counts.push_back(static_cast<std::uint32_t>(i * i % 1000));
+                journal.ticks.push_back(Tick { time, 100.0 + static_cast<double>(i % 13) / 8, static_cast<std::uint8_t>(i % 2) });
+            }
+            return journal;
+        }
+    };
+
+    struct Series
+    {
+        serialization::Columns<Tick> ticks;
+
+        SERIALIZE(
+            STORE(&Series::ticks, "ticks")
+        );
+    };
+
+    struct Currency
+    {
+        std::string code;
+        double rate = 0;
+
+        SERIALIZE(
+            STORE(&Currency::code, "code"),
+            STORE(&Currency::rate, "rate")
+        );
+    };
+
+    struct Trade
+    {
+        serialization::Cached<Currency> currency;
+        double amount = 0;
+
+        SERIALIZE(
+            STORE(&Trade::currency, "currency"),
+            STORE(&Trade::amount, "amount")
+        );
+    };
+
+    struct Node
+    {
+        int value = 0;
+        std::shared_ptr<Node> next;
+
+        SERIALIZE(
+            STORE(&Node::value, "value"),
+            STORE(&Node::next, "next")
+        );
+    };
+
+    struct Link
+    {
+        std::shared_ptr<Node> node;
+
+        SERIALIZE(
+            STORE(&Link::node, "node")
+        );
+    };
+
+    struct Graph
+    {
+        std::shared_ptr<Node> first;
+        serialization::Cached<Link> link;
+        std::vector<std::shared_ptr<Node>> all;
+        std::shared_ptr<Node> last;
+
+        SERIALIZE(
+            STORE(&Graph::first, "first"),
+            STORE(&Graph::link, "link"),
+            STORE(&Graph::all, "all"),
+            STORE(&Graph::last, "last")
+        );
+    };
+
+    struct Shape
+    {
+        virtual ~Shape() = default;
+        int id = 0;
+
+        SERIALIZE(
+            STORE(&Shape::id, "id")
+        );
+    };
+
+    struct Circle : Shape
+    {
+        double radius = 0;
+
+        SERIALIZE_BASE(Shape,
+            STORE(&Circle::radius, "radius")
+        );
+    };
+
+    struct Rectangle : Shape
+    {
+        double width = 0;
+        double height = 0;
+
+        SERIALIZE_BASE(Shape,
+            STORE(&Rectangle::width, "width"),
+            STORE(&Rectangle::height, "height")
+        );
+    };
+
+    struct Drawing
+    {
+        std::vector<std::unique_ptr<Shape>> shapes;
+        std::shared_ptr<Shape> selected;
+        std::shared_ptr<Shape> hovered;
+
+        SERIALIZE(
+            STORE(&Drawing::shapes, "shapes"),
+            STORE(&Drawing::selected, "selected"),
+            STORE(&Drawing::hovered, "hovered")
+        );
+    };
+
+    struct Player : serialization::Trackable
+    {
+        int score = 0;
+        std::string name;
+
+        SERIALIZE(
+            STORE(&Player::score, "score"),
+            STORE(&Player::name, "name")
+        );
+    };
+
+    struct Event
+    {
+        std::int64_t id = 0;
+        std::string what;
+
+        SERIALIZE(
+            STORE(&Event::id, "id"),
+            STORE(&Event::what, "what")
+        );
+    };
+}
+
+/** TESTS */
+template<typename Archive>
+void objects()
+{
+    const types::Parent parent = types::Parent::make();
+    const Archive archive = serialization::serialize<Archive>(parent);
+
+    types::Parent first;
+    types::Parent second;
+    serialization::deserialize<Archive>(archive, first);
+    serialization::deserialize<Archive>(archive, second);
+    CHECK(first == parent);
+    CHECK(second == parent);
+}
+
+template<typename Archive>
+void files()
+{
+    const types::Parent parent = types::Parent::make();
+    Archive archive = serialization::serialize<Archive>(parent);
+    const serialization::Compression compressions[] = { serialization::Compression::None, serialization::Compression::Lz };
+    const serialization::Checksum checksums[] = { serialization::Checksum::None, serialization::Checksum::Crc32c };
+
+    TemporaryFile file("file");
+    for(serialization::Compression compression : compressions)
+    {
+        for(serialization::Checksum checksum : checksums)
+        {
+            CHECK(archive.saveToFile(file.get(), compression, checksum));
+            Archive loaded;
+            CHECK(loaded.loadFromFile(file.get(), compression, checksum));
+            types::Parent result;
+            serialization::deserialize<Archive>(loaded, result);
+            CHECK(result == parent);
+        }
+    }
+}
+
+template<typename Archive>
+void codecs()
+{
+    const types::Journal journal = types::Journal::make(1000);
+    const Archive archive = serialization::serialize<Archive>(journal);
+
+    types::Journal result;
+    serialization::deserialize<Archive>(archive, result);
+    CHECK(result.timestamps == journal.timestamps);
+    CHECK(result.counts == journal.counts);
+    CHECK(result.ticks == journal.ticks);
+
+
+    types::Series series;
+    series.ticks = journal.ticks;
+    const Archive columns = serialization::serialize<Archive>(series);
+    std::vector<double> prices = columns.template retrieveColumn<types::Tick, &types::Tick::price>("ticks");
+    CHECK(prices.size() == series.ticks.size());
+    CHECK(prices[999] == series.ticks[999].price);
+}
+
+template<typename Archive>
+void cached()
+{
+    types::Trade trade;
+    trade.currency = types::Currency { "EUR", 1.1 };
+    trade.amount = 10;
+
+    for(double rate : { 1.1, 1.1, 1.2 })
+    {
+        trade.currency.modify().rate = rate;
+        const Archive archive = serialization::serialize<Archive>(trade);
+        types::Trade result;
+        serialization::deserialize<Archive>(archive, result);
+        CHECK(result.currency.get().code == "EUR");
+        CHECK(result.currency.get().rate == rate);
+        CHECK(result.amount == 10);
+    }
+}
+
+template<typename Archive>
+void sharedPointers()
+{
+    types::Graph graph;
+    graph.first = std::make_shared<types::Node>();
+    graph.first->value = 1;
+    graph.first->next = std::make_shared<types::Node>();
+    graph.first->next->value = 2;
+    graph.first->next->next = graph.first;
+    types::Link link;
+    link.node = std::make_shared<types::Node>();
+    link.node->value = 3;
+    graph.link = link;
+    graph.all = { graph.first, graph.first->next, link.node };
+    graph.last = graph.first->next;
+
+    // a second serialization copies the kept bytes of the Cached property
+    for(int i = 0; i < 2; i++)
+    {
+        const Archive archive = serialization::serialize<Archive>(graph);
+        types::Graph result;
+        serialization::deserialize<Archive>(archive, result);
+        CHECK(result.first->value == 1);
+        CHECK(result.first->next->next == result.first);
+        CHECK(result.link.get().node->value == 3);
+        CHECK(result.all.size() == 3);
+        CHECK(result.all[0] == result.first && result.all[1] == result.last && result.all[2] == result.link.get().node);
+        result.first->next->next.reset();
+    }
+    graph.first->next->next.reset();
+}
+
+template<typename Archive>
+void polymorphicPointers()
+{
+    serialization::registerType<types::Shape, types::Circle>(1);
+    serialization::registerType<types::Shape, types::Rectangle>(2);
+
+    types::Drawing drawing;
+    auto circle = std::make_unique<types::Circle>();
+    circle->id = 1;
+    circle->radius = 2.5;
+    auto rectangle = std::make_unique<types::Rectangle>();
+    rectangle->id = 2;
+    rectangle->width = 3;
+    rectangle->height = 4;
+    drawing.shapes.push_back(std::move(circle));
+    drawing.shapes.push_back(std::move(rectangle));
+    drawing.selected = std::make_shared<types::Rectangle>();
+    drawing.hovered = drawing.selected;
+
+    const Archive archive = serialization::serialize<Archive>(drawing);
+    types::Drawing result;
+    serialization::deserialize<Archive>(archive, result);
+    CHECK(result.shapes.size() == 2);
+    const auto* resultCircle = dynamic_cast<const types::Circle*>(result.shapes[0].get());
+    const auto* resultRectangle = dynamic_cast<const types::Rectangle*>(result.shapes[1].get());
+    CHECK(resultCircle && resultCircle->id == 1 && resultCircle->radius == 2.5);
+    CHECK(resultRectangle && resultRectangle->id == 2 && resultRectangle->width == 3 && resultRectangle->height == 4);
+    CHECK(std::dynamic_pointer_cast<types::Rectangle>(result.selected));
+    CHECK(result.selected == result.hovered);
+}
+
+template<typename Archive>
+void deltas()
+{
+    const types::Parent baseline = types::Parent::make();
+    types::Parent current = types::Parent::make();
+    current.child.age = 33;
+    current.ids.push_back(4);
+
+    const Archive delta = serialization::serializeDelta<Archive>(current, baseline);
+    types::Parent replica = types::Parent::make();
+    serialization::applyDelta(delta, replica);
+    CHECK(replica == current);
+
+    types::Player player;
+    serialization::set<&types::Player::score>(player, 10);
+    const Archive dirty = serialization::serializeDirty<Archive>(player);
+    types::Player remote;
+    remote.name = "remote";
+    serialization::applyDelta(dirty, remote);
+    CHECK(remote.score == 10 && remote.name == "remote");
+}
+
+template<typename Archive>
+void partial()
+{
+    const types::Parent parent = types::Parent::make();
+    const Archive archive = serialization::serialize<Archive>(parent);
+
+    types::Parent result;
+    serialization::deserialize<Archive>(archive, result, serialization::fields<&types::Parent::age, &types::Parent::ids>);
+    CHECK(result.age == parent.age && result.ids == parent.ids);
+    CHECK(result.name.empty() && result.child.name.empty() && result.scores.empty());
+
+    types::Graph graph;
+    graph.first = std::make_shared<types::Node>();
+    graph.first->value = 7;
+    graph.last = graph.first;
+    const Archive shared = serialization::serialize<Archive>(graph);
+    types::Graph last;
+    serialization::deserialize<Archive>(shared, last, serialization::fields<&types::Graph::last>);
+    CHECK(!last.first && last.last && last.last->value == 7);
+}
+
+template<typename Archive>
+void lazy()
+{
+    const types::Parent parent = types::Parent::make();
+    const Archive archive = serialization::serialize<Archive>(parent);
+
+    auto object = serialization::lazyDeserialize<types::Parent>(archive);
+    CHECK(object.template get<&types::Parent::scores>() == parent.scores);
+    CHECK(object.template get<&types::Parent::name>() == parent.name);
+    CHECK(object.template get<&types::Parent::child>().age == parent.child.age);
+
+    types::Graph graph;
+    graph.first = std::make_shared<types::Node>();
+    graph.last = graph.first;
+    const Archive shared = serialization::serialize<Archive>(graph);
+    auto lazyGraph = serialization::lazyDeserialize<types::Graph>(shared);
+    CHECK(lazyGraph.template get<&types::Graph::last>() == lazyGraph.template get<&types::Graph::first>());
+}
+
+void batches()
+{
+    std::vector<types::Parent> parents;
+    for(int i = 0; i < 1000; i++)
+    {
+        types::Parent parent = types::Parent::make();
+        parent.age = i;
+        parent.child.name = "child " + std::to_string(i % 10);
+        parents.push_back(parent);
+    }
+
+    for(std::size_t chunkSize : { 0, 1, 7, 256, 1000, 5000 })
+    {
+        const BinaryArchive archive = serialization::serializeBatch<BinaryArchive>(parents, chunkSize);
+        for(unsigned threads : { 1u, 4u })
+        {
+            std::vector<types::Parent> result(3);
+            serialization::deserializeBatch(archive, result, threads);
+            CHECK(result == parents);
+        }
+    }
+
+    const std::vector<types::Parent> none;
+    std::vector<types::Parent> result(3);
+    serialization::deserializeBatch(serialization::serializeBatch<BinaryArchive>(none, 16), result);
+    CHECK(result.empty());
+}
+
+void buffers()
+{
+    std::string text;
+    for(int i = 0; i < 100000; i++)
+    {
+        text += "record " + std::to_string(i % 1000) + ";";
+    }
+    for(serialization::Checksum checksum : { serialization::Checksum::None, serialization::Checksum::Crc32c })
+    {
+        for(const std::string& bytes : { std::string(), std::string("x"), text })
+        {
+            CHECK(serialization::decompress(serialization::compress(bytes, serialization::Compression::Lz, checksum)) == bytes);
+            CHECK(serialization::decompress(serialization::compress(bytes, serialization::Compression::None, checksum)) == bytes);
+        }
+    }
+    CHECK(serialization::compress(text).size() < text.size() / 4);
+
+    std::string packed = serialization::compress(text, serialization::Compression::Lz, serialization::Checksum::Crc32c);
+    packed[packed.size() / 2] ^= 0x10;
+    CHECK_THROWS(serialization::decompress(packed));
+
+    CHECK(serialization::detail::crc32c("123456789") == 0xE3069283);
+}
+
+void plainFiles()
+{
+    // a plain binary archive may start with the same bytes as a compressed file
+    types::Tick tick { 0x315A5053, 1, 2 };
+    BinaryArchive archive = serialization::serialize<BinaryArchive>(tick);
+    TemporaryFile file("plain");
+    CHECK(archive.saveToFile(file.get()));
+
+    BinaryArchive loaded;
+    CHECK(loaded.loadFromFile(file.get()));
+    types::Tick result;
+    serialization::deserialize<BinaryArchive>(loaded, result);
+    CHECK(result == tick);
+
+    CHECK(archive.saveToFile(file.get(), serialization::Compression::Lz));
+    CHECK_THROWS(loaded.loadFromFile(file.get(), serialization::Compression::Lz, serialization::Checksum::Crc32c));
+}
+
+template<typename Archive>
+std::vector<types::Event> readEvents(const std::string& filepath)
+{
+    std::vector<types::Event> events;
+    for(const types::Event& event : serialization::readStream<Archive, types::Event>(filepath))
+    {
+        events.push_back(event);
+    }
+    return events;
+}
+
+template<typename Archive>
+void streams()
+{
+    std::vector<types::Event> events;
+    for(int i = 0; i < 2000; i++)
+    {
+        events.push_back(types::Event { i, "event " + std::to_string(i) });
+    }
+
+    TemporaryFile file("stream");
+    for(serialization::Compression compression : { serialization::Compression::None, serialization::Compression::Lz })
+    {
+        for(serialization::Checksum checksum : { serialization::Checksum::None, serialization::Checksum::Crc32c })
+        {
+            CHECK(serialization::writeStream<Archive>(file.get(), events, compression, checksum));
+            std::size_t count = 0;
+            for(const types::Event& event : serialization::readStream<Archive, types::Event>(file.get(), 4096))
+            {
+                CHECK(event.id == events[count].id && event.what == events[count].what);
+                count++;
+            }
+            CHECK(count == events.size());
+        }
+    }
+
+    // a changed byte is noticed by the record checksums
+    CHECK(serialization::writeStream<Archive>(file.get(), events, serialization::Compression::None, serialization::Checksum::Crc32c));
+    {
+        std::fstream stream(file.get(), std::ios::in | std::ios::out | std::ios::binary);
+        stream.seekp(12);
+        stream.put('#');
+    }
+    CHECK_THROWS(readEvents<Archive>(file.get()));
+}
+
+template<typename Archive>
+void writers()
+{
+    TemporaryFile file("writer");
+    {
+        serialization::ArchiveWriter<Archive, types::Event> writer(file.get(), serialization::Checksum::Crc32c, 64);
+        for(int i = 0; i < 100; i++)
+        {
+            CHECK(writer.append(types::Event { i, "first" }));
+        }
+    }
+    {
+        // appending to an existing stream keeps its checksums
+        serialization::ArchiveWriter<Archive, types::Event> writer(file.get());
+        for(int i = 100; i < 150; i++)
+        {
+            CHECK(writer.append(types::Event { i, "second" }));
+        }
+        CHECK(writer.flush());
+    }
+    std::vector<types::Event> events = readEvents<Archive>(file.get());
+    CHECK(events.size() == 150);
+    for(int i = 0; i < 150; i++)
+    {
+        CHECK(events[static_cast<std::size_t>(i)].id == i);
+    }
+
+    // a record cut off by a crash is dropped when the stream is continued
+    std::filesystem::resize_file(file.get(), std::filesystem::file_size(file.get()) - 3);
+    {
+        serialization::ArchiveWriter<Archive, types::Event> writer(file.get());
+        CHECK(writer.append(types::Event { 1000, "after" }));
+    }
+    events = readEvents<Archive>(file.get());
+    CHECK(events.size() == 150);
+    CHECK(events[148].id == 148 && events.back().id == 1000 && events.back().what == "after");
+}
+
+/** RUNNER */
+int main(int argc, char** argv)
+{
+    const std::string filter = argc > 1 ? argv[1] : "";
+    const std::vector<std::pair<std::string, std::function<void()>>> tests = {
+        { "json/objects", objects<JsonArchive> },
+        { "binary/objects", objects<BinaryArchive> },
+        { "json/files", files<JsonArchive> },
+        { "binary/files", files<BinaryArchive> },
+        { "json/codecs", codecs<JsonArchive> },
+        { "binary/codecs", codecs<BinaryArchive> },
+        { "json/cached", cached<JsonArchive> },
+        { "binary/cached", cached<BinaryArchive> },
+        { "json/shared", sharedPointers<JsonArchive> },
+        { "binary/shared", sharedPointers<BinaryArchive> },
+        { "json/polymorphic", polymorphicPointers<JsonArchive> },
+        { "binary/polymorphic", polymorphicPointers<BinaryArchive> },
+        { "json/delta", deltas<JsonArchive> },
+        { "binary/delta", deltas<BinaryArchive> },
+        { "json/fields", partial<JsonArchive> },
+        { "binary/fields", partial<BinaryArchive> },
+        { "json/lazy", lazy<JsonArchive> },
+        { "binary/lazy", lazy<BinaryArchive> },
+        { "binary/batches", batches },
+        { "compression/buffers", buffers },
+        { "compression/plain", plainFiles },
+        { "json/streams", streams<JsonArchive> },
+        { "binary/streams", streams<BinaryArchive> },
+        { "json/writer", writers<JsonArchive> },
+        { "binary/writer", writers<BinaryArchive> },
+    };
+
+    int failed = 0;
+    for(const auto& test : tests)
+    {
+        if(test.first.find(filter) == std::string::npos)
+        {
+            continue;
+        }
+        try
+        {
+            test.second();
+            std::printf("passed %s\n", test.first.c_str());
+        }
+        catch(const std::exception& error)
+        {
+            std::printf("FAILED %s: %s\n", test.first.c_str(), error.what());
+            failed++;
+        }
+    }
+    return failed ? 1 : 0;
+}